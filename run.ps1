@@ -58,6 +58,9 @@ if($compileShaders){
     & $glslang -V "src/client/renderer/shaders/shadow.vert" -o "build/$config/shaders/shadowVert.spv"
     if ($LASTEXITCODE -ne 0) { exit 1 }
 
+    & $glslang -V "src/client/renderer/shaders/cull.comp" -o "build/$config/shaders/cullComp.spv"
+    if ($LASTEXITCODE -ne 0) { exit 1 }
+
     & $glslang -V "src/client/renderer/shaders/post.vert" -o "build/$config/shaders/postVert.spv"
     if ($LASTEXITCODE -ne 0) { exit 1 }
 
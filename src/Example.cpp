@@ -82,6 +82,7 @@ private:
     void setupScene()
     {
         scene.setBackgroundColor({0.7f, 1.0f, 1.0f, 1.0f});
+        scene.setSun({-10.0f, 100.0f, 30.0f}, {1.0f, 1.0f, 0.8f, 1.0f}, 3.0f);
 
         // Vehicle
         VehicleCreateInfo carInfo = {};
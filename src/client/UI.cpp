@@ -6,6 +6,8 @@
 #include "../shared/HandleFactory.hpp"
 
 #include "../shared/Log.hpp"
+#include "../shared/AssetFormat.hpp"
+#include "../shared/local.hpp"
 
 #include <array>
 
@@ -31,15 +33,22 @@ namespace VE
     {
         std::string ext = std::filesystem::path(filePath).extension().string();
 
-        if (ext != ".obj")
+        std::vector<Mesh> meshes;
+
+        if (ext == COOKED_MODEL_EXTENSION)
+        {
+            meshes = loadCookedModel(filePath).meshes;
+        }
+        else if (ext == ".obj" && !COOKED_ASSETS_ONLY)
+        {
+            meshes = loadOBJ(filePath).meshes;
+        }
+        else
         {
             Log::add('E', 101);
             return INVALID_WIDGET_HANDLE;
         }
 
-        WidgetHandle newWidgetHandle = HandleFactory<WidgetHandle>::getNewHandle();
-
-        std::vector<Mesh> meshes = loadOBJ(filePath).meshes;
         Log::add('W', 100);
 
         if (meshes.empty())
@@ -48,6 +57,8 @@ namespace VE
             return INVALID_WIDGET_HANDLE;
         }
 
+        WidgetHandle newWidgetHandle = HandleFactory<WidgetHandle>::getNewHandle();
+
         widgets.emplace_back(newWidgetHandle, meshes);
 
         return newWidgetHandle;
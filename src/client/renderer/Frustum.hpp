@@ -0,0 +1,87 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "../../shared/definitions.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace VE
+{
+
+    // Inward facing planes, a point p is inside one when dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum
+    {
+        std::array<glm::vec4, 6> planes;
+    };
+
+    // Spheres as a structure of arrays, so cullSpheres compares four to eight of them per instruction
+    struct SphereList
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+
+        void clear()
+        {
+            centerX.clear();
+            centerY.clear();
+            centerZ.clear();
+            radius.clear();
+        }
+
+        void add(const glm::vec3 &center, float sphereRadius)
+        {
+            centerX.push_back(center.x);
+            centerY.push_back(center.y);
+            centerZ.push_back(center.z);
+            radius.push_back(sphereRadius);
+        }
+
+        [[nodiscard]] size_t size() const { return radius.size(); }
+    };
+
+    // Gribb-Hartmann plane extraction. The near plane uses the -1..1 clip depth, which contains the 0..1 one
+    [[nodiscard]] static Frustum extractFrustum(const glm::mat4 &viewProjMat)
+    {
+        const glm::vec4 row0(viewProjMat[0][0], viewProjMat[1][0], viewProjMat[2][0], viewProjMat[3][0]);
+        const glm::vec4 row1(viewProjMat[0][1], viewProjMat[1][1], viewProjMat[2][1], viewProjMat[3][1]);
+        const glm::vec4 row2(viewProjMat[0][2], viewProjMat[1][2], viewProjMat[2][2], viewProjMat[3][2]);
+        const glm::vec4 row3(viewProjMat[0][3], viewProjMat[1][3], viewProjMat[2][3], viewProjMat[3][3]);
+
+        Frustum frustum;
+        frustum.planes = {row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2};
+
+        for (glm::vec4 &plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        return frustum;
+    }
+
+    // Sets visible[i] to 1 when sphere i touches the frustum and 0 otherwise
+    static void cullSpheres(const Frustum &frustum, const SphereList &spheres, std::vector<uint8_t> &visible)
+    {
+        const size_t count = spheres.size();
+        visible.assign(count, 1);
+
+        const float *centerX = spheres.centerX.data();
+        const float *centerY = spheres.centerY.data();
+        const float *centerZ = spheres.centerZ.data();
+        const float *radius = spheres.radius.data();
+        uint8_t *result = visible.data();
+
+        // One plane per pass with no branches in the loop body, so the compiler vectorizes it
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+                result[i] &= static_cast<uint8_t>(distance >= -radius[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,301 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#include "MemoryAllocator.hpp"
+
+#include "../../shared/Log.hpp"
+
+#include <algorithm>
+
+namespace VE
+{
+
+    void RangeAllocator::init(VkDeviceSize size)
+    {
+        this->size = size;
+        usedBytes = 0;
+        allocationCount = 0;
+        freeRanges = {{0, size}};
+    }
+
+    bool RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+    {
+        // Best fit: the smallest free range that still holds the aligned allocation
+        auto bestRange = freeRanges.end();
+        VkDeviceSize bestOffset = 0;
+        VkDeviceSize bestRangeSize = UINT64_MAX;
+
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            const VkDeviceSize alignedOffset = (it->first + alignment - 1) / alignment * alignment;
+            const VkDeviceSize rangeEnd = it->first + it->second;
+
+            if (alignedOffset + size <= rangeEnd && it->second < bestRangeSize)
+            {
+                bestRange = it;
+                bestOffset = alignedOffset;
+                bestRangeSize = it->second;
+            }
+        }
+
+        if (bestRange == freeRanges.end())
+            return false;
+
+        const VkDeviceSize rangeBegin = bestRange->first;
+        const VkDeviceSize rangeEnd = bestRange->first + bestRange->second;
+
+        freeRanges.erase(bestRange);
+
+        if (bestOffset > rangeBegin)
+            freeRanges.emplace(rangeBegin, bestOffset - rangeBegin);
+
+        if (bestOffset + size < rangeEnd)
+            freeRanges.emplace(bestOffset + size, rangeEnd - bestOffset - size);
+
+        usedBytes += size;
+        allocationCount++;
+
+        *offset = bestOffset;
+        return true;
+    }
+
+    void RangeAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+    {
+        VkDeviceSize rangeBegin = offset;
+        VkDeviceSize rangeSize = size;
+
+        auto next = freeRanges.lower_bound(rangeBegin);
+
+        if (next != freeRanges.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == rangeBegin)
+            {
+                rangeBegin = previous->first;
+                rangeSize += previous->second;
+                freeRanges.erase(previous);
+            }
+        }
+
+        if (next != freeRanges.end() && rangeBegin + rangeSize == next->first)
+        {
+            rangeSize += next->second;
+            freeRanges.erase(next);
+        }
+
+        freeRanges.emplace(rangeBegin, rangeSize);
+
+        usedBytes -= size;
+        allocationCount--;
+    }
+
+    void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device)
+    {
+        this->device = device;
+
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    }
+
+    void MemoryAllocator::destroy()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (MemoryPool &pool : pools)
+        {
+            for (MemoryBlock &block : pool.blocks)
+            {
+                if (block.memory != VK_NULL_HANDLE)
+                    vkFreeMemory(device, block.memory, nullptr);
+            }
+        }
+
+        pools.clear();
+    }
+
+    uint32_t MemoryAllocator::findMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags properties) const
+    {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((allowedTypes & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+            {
+                return i;
+            }
+        }
+
+        Log::add('V', 237);
+        return -1;
+    }
+
+    bool MemoryAllocator::isHostVisible(uint32_t memoryTypeIndex) const
+    {
+        return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+
+    VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void **mappedData) const
+    {
+        VkMemoryAllocateInfo memoryAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = size,
+            .memoryTypeIndex = memoryTypeIndex};
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (vkAllocateMemory(device, &memoryAllocInfo, nullptr, &memory) != VK_SUCCESS)
+            Log::add('V', 242);
+
+        *mappedData = nullptr;
+        if (isHostVisible(memoryTypeIndex) && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS)
+            Log::add('V', 236);
+
+        return memory;
+    }
+
+    MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, MemoryResourceKind kind)
+    {
+        const uint32_t memoryTypeIndex = findMemoryTypeIndex(requirements.memoryTypeBits, properties);
+
+        MemoryAllocation allocation;
+        allocation.size = requirements.size;
+
+        if (requirements.size > DEDICATED_ALLOCATION_THRESHOLD)
+        {
+            allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mappedData);
+            allocation.isDedicated = true;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            dedicatedAllocationCount++;
+            dedicatedBytes += requirements.size;
+
+            return allocation;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint32_t poolIndex = 0;
+        while (poolIndex < pools.size() && (pools[poolIndex].memoryTypeIndex != memoryTypeIndex || pools[poolIndex].kind != kind))
+            poolIndex++;
+
+        if (poolIndex == pools.size())
+            pools.push_back({memoryTypeIndex, kind, {}});
+
+        MemoryPool &pool = pools[poolIndex];
+
+        uint32_t blockIndex = 0;
+        for (; blockIndex < pool.blocks.size(); blockIndex++)
+        {
+            MemoryBlock &block = pool.blocks[blockIndex];
+            if (block.memory != VK_NULL_HANDLE && block.ranges.allocate(requirements.size, requirements.alignment, &allocation.offset))
+                break;
+        }
+
+        if (blockIndex == pool.blocks.size())
+        {
+            // Reuse the slot of a released block before growing the list
+            blockIndex = 0;
+            while (blockIndex < pool.blocks.size() && pool.blocks[blockIndex].memory != VK_NULL_HANDLE)
+                blockIndex++;
+
+            if (blockIndex == pool.blocks.size())
+                pool.blocks.emplace_back();
+
+            MemoryBlock &block = pool.blocks[blockIndex];
+            block.memory = allocateDeviceMemory(BLOCK_SIZE, memoryTypeIndex, &block.mappedData);
+            block.ranges.init(BLOCK_SIZE);
+
+            (void)block.ranges.allocate(requirements.size, requirements.alignment, &allocation.offset);
+        }
+
+        const MemoryBlock &block = pool.blocks[blockIndex];
+
+        allocation.memory = block.memory;
+        allocation.poolIndex = poolIndex;
+        allocation.blockIndex = blockIndex;
+        if (block.mappedData)
+            allocation.mappedData = static_cast<uint8_t *>(block.mappedData) + allocation.offset;
+
+        return allocation;
+    }
+
+    void MemoryAllocator::free(MemoryAllocation &allocation)
+    {
+        if (allocation.memory == VK_NULL_HANDLE)
+            return;
+
+        if (allocation.isDedicated)
+        {
+            vkFreeMemory(device, allocation.memory, nullptr);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            dedicatedAllocationCount--;
+            dedicatedBytes -= allocation.size;
+
+            allocation = {};
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        MemoryPool &pool = pools[allocation.poolIndex];
+        MemoryBlock &block = pool.blocks[allocation.blockIndex];
+
+        block.ranges.free(allocation.offset, allocation.size);
+
+        // Release empty blocks, but keep one per pool so a load/unload cycle does not thrash
+        if (block.ranges.getAllocationCount() == 0)
+        {
+            uint32_t liveBlockCount = 0;
+            for (const MemoryBlock &poolBlock : pool.blocks)
+            {
+                if (poolBlock.memory != VK_NULL_HANDLE)
+                    liveBlockCount++;
+            }
+
+            if (liveBlockCount > 1)
+            {
+                vkFreeMemory(device, block.memory, nullptr);
+                block = {};
+            }
+        }
+
+        allocation = {};
+    }
+
+    MemoryStats MemoryAllocator::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        MemoryStats stats;
+        stats.dedicatedAllocationCount = dedicatedAllocationCount;
+        stats.allocationCount = dedicatedAllocationCount;
+        stats.reservedBytes = dedicatedBytes;
+        stats.usedBytes = dedicatedBytes;
+
+        VkDeviceSize freeBytes = 0;
+
+        for (const MemoryPool &pool : pools)
+        {
+            for (const MemoryBlock &block : pool.blocks)
+            {
+                if (block.memory == VK_NULL_HANDLE)
+                    continue;
+
+                stats.blockCount++;
+                stats.allocationCount += block.ranges.getAllocationCount();
+                stats.reservedBytes += block.ranges.getSize();
+                stats.usedBytes += block.ranges.getUsedBytes();
+
+                for (const auto &[offset, size] : block.ranges.getFreeRanges())
+                {
+                    stats.freeRangeCount++;
+                    stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+                    freeBytes += size;
+                }
+            }
+        }
+
+        if (freeBytes > 0)
+            stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(freeBytes);
+
+        return stats;
+    }
+
+}
@@ -0,0 +1,120 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace VE
+{
+
+    enum MemoryResourceKind
+    {
+        MEMORY_RESOURCE_KIND_BUFFER,
+        MEMORY_RESOURCE_KIND_IMAGE
+    };
+
+    // Best fit suballocation of a linear range, free neighbours are coalesced
+    class RangeAllocator
+    {
+    public:
+        void init(VkDeviceSize size);
+
+        [[nodiscard]] bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset);
+        void free(VkDeviceSize offset, VkDeviceSize size);
+
+        [[nodiscard]] VkDeviceSize getSize() const { return size; }
+        [[nodiscard]] VkDeviceSize getUsedBytes() const { return usedBytes; }
+        [[nodiscard]] uint32_t getAllocationCount() const { return allocationCount; }
+        [[nodiscard]] const std::map<VkDeviceSize, VkDeviceSize> &getFreeRanges() const { return freeRanges; }
+
+    private:
+        VkDeviceSize size = 0;
+        VkDeviceSize usedBytes = 0;
+        uint32_t allocationCount = 0;
+
+        // Offset -> size
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+    };
+
+    struct MemoryAllocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+
+        // Host visible memory stays mapped for its whole lifetime
+        void *mappedData = nullptr;
+
+        uint32_t poolIndex = 0;
+        uint32_t blockIndex = 0;
+        bool isDedicated = false;
+    };
+
+    struct MemoryStats
+    {
+        uint32_t blockCount = 0;
+        uint32_t dedicatedAllocationCount = 0;
+        uint32_t allocationCount = 0;
+
+        VkDeviceSize reservedBytes = 0;
+        VkDeviceSize usedBytes = 0;
+
+        uint32_t freeRangeCount = 0;
+        VkDeviceSize largestFreeRange = 0;
+
+        // 0 when all free space in a block is one range, approaching 1 as it splinters
+        float fragmentation = 0.0f;
+    };
+
+    class MemoryAllocator
+    {
+    public:
+        void init(VkPhysicalDevice physicalDevice, VkDevice device);
+        void destroy();
+
+        [[nodiscard]] MemoryAllocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, MemoryResourceKind kind);
+        void free(MemoryAllocation &allocation);
+
+        [[nodiscard]] MemoryStats getStats() const;
+
+    private:
+        static constexpr VkDeviceSize BLOCK_SIZE = 64ull * 1024 * 1024;
+        static constexpr VkDeviceSize DEDICATED_ALLOCATION_THRESHOLD = BLOCK_SIZE / 2;
+
+        struct MemoryBlock
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mappedData = nullptr;
+
+            RangeAllocator ranges;
+        };
+
+        // Buffers and images never share a block, which keeps bufferImageGranularity out of the picture
+        struct MemoryPool
+        {
+            uint32_t memoryTypeIndex;
+            MemoryResourceKind kind;
+            std::vector<MemoryBlock> blocks;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties memoryProperties = {};
+
+        std::vector<MemoryPool> pools;
+
+        uint32_t dedicatedAllocationCount = 0;
+        VkDeviceSize dedicatedBytes = 0;
+
+        mutable std::mutex mutex;
+
+        [[nodiscard]] uint32_t findMemoryTypeIndex(uint32_t allowedTypes, VkMemoryPropertyFlags properties) const;
+        [[nodiscard]] bool isHostVisible(uint32_t memoryTypeIndex) const;
+        [[nodiscard]] VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void **mappedData) const;
+    };
+
+}
@@ -5,59 +5,60 @@
 
 #include "../../shared/DrawData.hpp"
 
+#include "MemoryAllocator.hpp"
+#include "Frustum.hpp"
+
 #include "../../shared/Log.hpp"
+#include "../../shared/MpmcQueue.hpp"
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
 #include <vector>
 #include <array>
+#include <deque>
+#include <unordered_map>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <semaphore>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
 
 namespace VE
 {
     static constexpr uint32_t INVALID_TEXTURE_INDEX = 0;
 
+    struct CookedTexture;
+    enum CookedTextureFormat : uint32_t;
+
     struct GraphicsPipeline
     {
         VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipeline packedPipeline = VK_NULL_HANDLE;
         VkPipelineLayout layout = VK_NULL_HANDLE;
         VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
         VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
         std::vector<VkDescriptorSet> descriptorSets;
     };
 
+    struct ComputePipeline
+    {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+    };
+
     struct ImageAttachment
     {
         VkImage image = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        MemoryAllocation memory;
         VkImageView imageView = VK_NULL_HANDLE;
         uint32_t mipLevelCount = 1;
-    };
-
-    class CommandPoolGuard
-    {
-        public:
-        CommandPoolGuard(VkDevice device, uint32_t queueFamilyIndex) : device(device)
-        {
-            VkCommandPoolCreateInfo poolCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-            .queueFamilyIndex = queueFamilyIndex};
-            if(vkCreateCommandPool(device, &poolCreateInfo, nullptr, &pool) != VK_SUCCESS)
-                Log::add('V', 208);
-        }
-
-        ~CommandPoolGuard()
-        {
-            vkDestroyCommandPool(device, pool, nullptr);
-        }
-
-        [[nodiscard]] operator VkCommandPool() const { return pool; }
 
-        private:
-            VkCommandPool pool = VK_NULL_HANDLE;
-            VkDevice device = VK_NULL_HANDLE;
+        // Only read for textures, whose views are created after the image
+        VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
     };
 
     class Renderer
@@ -67,32 +68,220 @@ namespace VE
 
         void drawFrame(const SceneDrawData &sceneDrawData, const UIDrawData &uiDrawData, const glm::mat4 projectionMat, const PostEffects& postEffects);
 
+        [[nodiscard]] MemoryStats getMemoryStats() const { return memoryAllocator.getStats(); }
+
         ~Renderer();
 
     private:
         static constexpr uint32_t FRAMES_IN_FLIGHT = 2;
 
-        static constexpr Size2 SHADOW_MAP_EXTENT = {4096, 4096};
+        // Each cascade is one layer of the shadow map
+        static constexpr uint32_t SHADOW_CASCADE_COUNT = 4;
+        static constexpr Size2 SHADOW_MAP_EXTENT = {2048, 2048};
+
+        // Cascades cover the camera frustum up to this distance, split between logarithmic and uniform by the lambda
+        static constexpr float SHADOW_DISTANCE = 300.0f;
+        static constexpr float SHADOW_SPLIT_LAMBDA = 0.8f;
+
+        // How far behind a cascade casters are still caught, along the light direction
+        static constexpr float SHADOW_CASTER_DISTANCE = 100.0f;
+
+        // Cached cascades are fitted this much larger than the camera needs, so they survive some camera movement before a refit
+        static constexpr float SHADOW_CACHE_MARGIN = 0.25f;
+
+        // Cosine of how far the light may turn, about half a degree, before every cascade is refitted
+        static constexpr float SHADOW_CACHE_MIN_LIGHT_DOT = 0.99996f;
+
+        // Size of the bindless texture array, slots of destroyed textures are reused
+        static constexpr uint32_t MAX_TEXTURE_COUNT = 4096;
+
+        // Cooked model textures load their mips up to this size, larger ones are streamed in when the screen needs them
+        static constexpr uint32_t TEXTURE_STREAMING_INITIAL_SIZE = 128;
 
-        static constexpr uint32_t TEXTURE_SAMPLER_POOL_CHUNK_SIZE = 1e3;
+        // VRAM for streamed texture mips, sized for 4 GB cards
+        static constexpr VkDeviceSize TEXTURE_STREAMING_BUDGET = 1024ull * 1024 * 1024;
+
+        // Streaming jobs in flight at once, so they don't hold up model uploads
+        static constexpr uint32_t TEXTURE_STREAMING_MAX_JOBS = 4;
+
+        // Closest distance mip demand is estimated at, so a mesh around the camera doesn't ask for infinite detail
+        static constexpr float TEXTURE_STREAMING_MIN_DISTANCE = 0.5f;
 
         static constexpr char PIPELINE_CACHE_FILE_NAME[] = "pipeline_cache.bin";
 
+        static constexpr VkDeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+        static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+        static constexpr uint32_t UPLOAD_WORKER_COUNT = 4;
+        static constexpr uint32_t UPLOAD_COMMAND_SLOT_COUNT = 2;
+        static constexpr size_t UPLOAD_JOB_QUEUE_CAPACITY = 1024;
+
+        // Texture files are read and decoded ahead of the upload workers, which only copy them to the GPU
+        static constexpr uint32_t DECODE_WORKER_COUNT = 4;
+        static constexpr size_t DECODE_JOB_QUEUE_CAPACITY = 1024;
+
+        static constexpr uint32_t INSTANCE_BUFFER_INITIAL_CAPACITY = 1024;
+        static constexpr uint32_t DRAW_BUFFER_INITIAL_CAPACITY = 1024;
+        static constexpr uint32_t VISIBLE_INSTANCE_BUFFER_INITIAL_CAPACITY = 4096;
+        static constexpr uint32_t LIGHT_BUFFER_INITIAL_CAPACITY = 256;
+        static constexpr uint32_t LIGHT_INDEX_BUFFER_INITIAL_CAPACITY = 4096;
+
+        // Point lights are binned into screen tiles times exponential depth slices, must match shader.frag
+        static constexpr uint32_t LIGHT_CLUSTER_COUNT_X = 16;
+        static constexpr uint32_t LIGHT_CLUSTER_COUNT_Y = 9;
+        static constexpr uint32_t LIGHT_CLUSTER_COUNT_Z = 24;
+        static constexpr uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_COUNT_X * LIGHT_CLUSTER_COUNT_Y * LIGHT_CLUSTER_COUNT_Z;
+
+        // Point lights farther than this from the camera are dropped
+        static constexpr float LIGHT_CLUSTER_DISTANCE = 300.0f;
+
+        // A point light reaches as far as its strength over squared distance stays above this
+        static constexpr float POINT_LIGHT_CUTOFF = 0.01f;
+
+        static constexpr VkDeviceSize GEOMETRY_VERTEX_PAGE_SIZE = 64ull * 1024 * 1024;
+        static constexpr VkDeviceSize GEOMETRY_INDEX_PAGE_SIZE = 32ull * 1024 * 1024;
+
+        struct GeometryRange
+        {
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = 0;
+        };
+
         struct MeshBuffer
         {
+            // Vertices and indices live in a shared geometry page
+            uint32_t geometryPageIndex = 0;
+            GeometryRange vertexRange;
+            GeometryRange indexRange;
+
             uint32_t vertexCount = 0;
-            VkBuffer vertexBuffer = VK_NULL_HANDLE;
-            VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+            int32_t vertexOffset = 0;
+
+            bool isPacked = false;
+            glm::mat4 dequantizeMat = glm::mat4(1.0f);
 
             uint32_t indexCount = 0;
-            VkBuffer indexBuffer = VK_NULL_HANDLE;
-            VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+            uint32_t firstIndex = 0;
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
 
             uint32_t materialIndex;
 
             uint32_t texIndex = INVALID_TEXTURE_INDEX;
 
+            // Texture coordinate units per model space unit, sizes the mip demand of the texture
+            float uvDensity = 0.0f;
+
             bool isTransparent = false;
+
+            MeshBounds bounds;
+        };
+
+        struct StagingRegion
+        {
+            VkDeviceSize begin;
+            VkDeviceSize end;
+
+            // Zero until the copies reading it are submitted
+            uint64_t timelineValue = 0;
+        };
+
+        struct DedicatedStagingBuffer
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            MemoryAllocation memory;
+            uint64_t timelineValue = 0;
+        };
+
+        struct StagingAllocation
+        {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            void *data;
+        };
+
+        struct UploadCommandSlot
+        {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+            // Recycled once the upload timeline reaches it
+            uint64_t timelineValue = 0;
+        };
+
+        // Transfer command buffers owned by one upload thread, one records while the other is in flight
+        struct UploadContext
+        {
+            std::array<UploadCommandSlot, UPLOAD_COMMAND_SLOT_COUNT> slots;
+            uint32_t currentSlot = 0;
+
+            // A second batch would record into the same slot, and wait on ring space the open one can only free once it ends
+            bool hasOpenBatch = false;
+        };
+
+        using UploadJob = std::function<void(UploadContext &context)>;
+
+        struct MipmapGeneration
+        {
+            VkImage image = VK_NULL_HANDLE;
+            int32_t width = 0;
+            int32_t height = 0;
+            uint32_t mipLevelCount = 1;
+        };
+
+        // Levels a streamed texture already has, copied from its old chain by the graphics queue that owns it
+        struct MipTailCopy
+        {
+            uint32_t texIndex = INVALID_TEXTURE_INDEX;
+            uint32_t generation = 0;
+
+            VkImage srcImage = VK_NULL_HANDLE;
+            uint32_t srcFirstLevel = 0;
+            VkImage dstImage = VK_NULL_HANDLE;
+            uint32_t dstFirstLevel = 0;
+
+            // The size is of the first level copied, the new chain has no levels below the copied ones
+            uint32_t levelCount = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+        };
+
+        // A streamed texture's first chain, which can be streamed from once its acquire is recorded
+        struct StreamedTextureAcquire
+        {
+            uint32_t texIndex = INVALID_TEXTURE_INDEX;
+            uint32_t generation = 0;
+        };
+
+        // Recorded by the graphics queue before it first touches what the transfer queue released
+        struct UploadAcquires
+        {
+            std::vector<VkBufferMemoryBarrier> bufferBarriers;
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+            std::vector<MipmapGeneration> mipmapGenerations;
+            std::vector<MipTailCopy> mipTailCopies;
+            std::vector<StreamedTextureAcquire> streamedTextures;
+        };
+
+        // Copies recorded into one transfer command buffer and submitted together
+        struct UploadBatch
+        {
+            UploadContext *context = nullptr;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+            bool hasCommands = false;
+
+            std::vector<StagingRegion *> stagingRegions;
+
+            // Uploads larger than the whole ring get their own staging buffer
+            std::vector<DedicatedStagingBuffer> dedicatedBuffers;
+
+            UploadAcquires acquires;
+
+            // Cached textures this batch uploads, ready once it is submitted
+            std::vector<std::promise<void>> textureUploads;
+
+            // Cached textures reused from batches that weren't submitted yet
+            std::vector<std::shared_future<void>> sharedTextureUploads;
         };
 
         struct ModelBuffer
@@ -104,9 +293,22 @@ namespace VE
 
             uint64_t version = 0;
 
+            // Refreshed by removeOrphanedModel
+            uint32_t instanceCount = 0;
+
+            // Published only after these are ready, see UploadBatch
+            std::vector<std::shared_future<void>> sharedTextureUploads;
+
             ModelBuffer(ModelHandle handle) : handle(handle) {}
         };
 
+        // Replaced or removed meshes stay alive until every frame that could draw them has finished
+        struct RetiredMeshBuffers
+        {
+            std::vector<MeshBuffer> meshBuffers;
+            uint64_t frameIndex = 0;
+        };
+
         struct WidgetBuffer
         {
             WidgetHandle handle;
@@ -115,6 +317,9 @@ namespace VE
 
             uint64_t version = 0;
 
+            // Published only after these are ready, see UploadBatch
+            std::vector<std::shared_future<void>> sharedTextureUploads;
+
             WidgetBuffer(WidgetHandle handle) : handle(handle) {}
         };
 
@@ -122,15 +327,28 @@ namespace VE
         {
             glm::mat4 projection;
             glm::mat4 view;
-            glm::mat4 lightSpaceMat;
+        };
+
+        struct ShadowCascades
+        {
+            std::array<glm::mat4, SHADOW_CASCADE_COUNT> lightSpaceMats;
+
+            // View space distance at which each cascade ends
+            glm::vec4 splitDepths;
         };
 
         struct UboLighting
         {
-            glm::vec4 lightPos;
-            glm::vec4 lightColor;
+            // Direction towards the sun and its strength
+            glm::vec4 sunDirection;
+            glm::vec4 sunColor;
             glm::vec4 viewPos;
+            ShadowCascades shadowCascades;
+
+            // Depth slice scale and bias for log(view depth), then the viewport size in pixels
+            glm::vec4 clusterParams;
             float outdoorBrightness;
+            uint32_t pointLightCount;
         };
 
         struct UboUI
@@ -138,26 +356,97 @@ namespace VE
             glm::mat4 orthographicProj;
         };
 
-        struct VertexPushData
+        // Matches InstanceData in shader.vert, shadow.vert and cull.comp, std430 packs the strength behind the color
+        struct InstanceData
         {
             glm::mat4 model;
-            uint32_t textureIndex;
+            glm::vec3 lightColor;
             float lightStrength;
         };
 
-        struct MaterialPushData
+        // Matches PointLight in shader.frag
+        struct PointLight
+        {
+            // World space position and range
+            glm::vec4 positionRadius;
+
+            // Color and strength
+            glm::vec4 colorStrength;
+        };
+
+        // A cluster's slice of the light index buffer
+        struct LightCluster
+        {
+            uint32_t firstLight;
+            uint32_t lightCount;
+        };
+
+        // Instances of one model, contiguous in the frame's instance buffer. Static and dynamic instances never share a batch
+        struct InstanceBatch
+        {
+            uint32_t modelBufferIndex;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+            bool isDynamic;
+        };
+
+        // Matches DrawData in shader.vert, shader.frag, shadow.vert and cull.comp, one per indirect command
+        struct DrawData
         {
+            glm::mat4 dequantizeMat;
             glm::vec4 baseColor;
             float metallic;
             float roughness;
+            uint32_t textureIndex;
+
+            // Culled draws only: the run's slot in the count buffer and its first compacted command
+            uint32_t countIndex;
+            uint32_t runFirstDraw;
+
+            // Culled draws only: start of the draw's slice of the visible instance buffer
+            uint32_t visibleOffset;
+            uint32_t padding[2];
+
+            // Mesh space center and radius
+            glm::vec4 boundingSphere;
+        };
+
+        // Consecutive indirect commands that share pipeline, geometry page and index type
+        struct DrawRun
+        {
+            VkPipeline pipeline;
+            uint32_t geometryPageIndex;
+            VkIndexType indexType;
+            uint32_t firstDraw;
+            uint32_t drawCount;
+
+            // Slot in the count buffer for runs compacted by the culling pass, UINT32_MAX otherwise
+            uint32_t countIndex;
+        };
+
+        struct DrawRange
+        {
+            uint32_t firstDraw = 0;
+            uint32_t drawCount = 0;
+        };
+
+        struct CullPushData
+        {
+            std::array<glm::vec4, 6> frustumPlanes;
+            uint32_t firstDraw;
+            uint32_t drawCount;
         };
 
-        static constexpr uint32_t materialPushDataStructOffset = (sizeof(VertexPushData) + 15u) & ~15u;
+        // gl_DrawID restarts at every indirect call, firstDraw offsets it into the frame's draw data
+        struct VertexPushData
+        {
+            uint32_t firstDraw;
+        };
 
         struct ShadowPushData
         {
-            glm::mat4 model;
             glm::mat4 lightSpaceMat;
+            uint32_t firstDraw;
         };
 
         struct UIPushData
@@ -191,6 +480,8 @@ namespace VE
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         VkDevice device = VK_NULL_HANDLE;
 
+        MemoryAllocator memoryAllocator;
+
         VkQueue graphicsQueue = VK_NULL_HANDLE;
         VkQueue presentQueue = VK_NULL_HANDLE;
         VkQueue transferQueue = VK_NULL_HANDLE;
@@ -216,25 +507,145 @@ namespace VE
         std::array<FrameData, FRAMES_IN_FLIGHT> frames;
 
         uint32_t currentFrame = 0;
+        uint64_t frameIndex = 0;
 
+        // Dense and unordered, looked up through the index maps keyed by handle value
         std::vector<ModelBuffer> modelBuffers;
         std::vector<WidgetBuffer> widgetBuffers;
+        std::unordered_map<uint64_t, uint32_t> modelBufferIndices;
+        std::unordered_map<uint64_t, uint32_t> widgetBufferIndices;
+
+        std::deque<RetiredMeshBuffers> retiredMeshBuffers;
 
         // Pipeline 1: Shadow
         GraphicsPipeline shadowPipeline;
 
         // Shadow attachments
+        // The attachment's view covers every cascade for sampling, the cascade views are rendered into one at a time
         ImageAttachment shadowDepthAttachment;
+        std::array<VkImageView, SHADOW_CASCADE_COUNT> shadowCascadeViews{};
         VkSampler shadowSampler = VK_NULL_HANDLE;
 
+        // Whether the shadow map is in SHADER_READ_ONLY, frames without a sun skip the shadow pass and leave it there
+        bool isShadowMapReadable = false;
+
+        // Static casters are drawn into the cache only when their cascade is refitted or the static scene changes,
+        // every frame copies it into the shadow map and draws the dynamic casters on top
+        struct ShadowCache
+        {
+            ImageAttachment staticAttachment;
+            std::array<VkImageView, SHADOW_CASCADE_COUNT> staticCascadeViews{};
+
+            // The cascades every layer was drawn with, and the camera slice spheres they were fitted to, grown by the margin
+            ShadowCascades cascades{};
+            std::array<glm::vec4, SHADOW_CASCADE_COUNT> cascadeSpheres{};
+            glm::vec3 lightDirection = glm::vec3(0.0f);
+            uint64_t staticInstanceVersion = 0;
+
+            std::array<bool, SHADOW_CASCADE_COUNT> isLayerValid{};
+        } shadowCache;
+
+        // Instances, shared by the shadow and main passes
+        struct InstanceResources
+        {
+            std::array<VkBuffer, FRAMES_IN_FLIGHT> buffers{};
+            std::array<MemoryAllocation, FRAMES_IN_FLIGHT> memories;
+            std::array<uint32_t, FRAMES_IN_FLIGHT> capacities{};
+
+            VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> descriptorSets;
+
+            // Rebuilt every frame, grouped by model
+            std::vector<InstanceData> data;
+            std::vector<InstanceBatch> batches;
+        } instanceResources;
+
+        // Pipeline 0: Culling, compacts the shadow and opaque draws before either pass
+        ComputePipeline cullPipeline;
+
+        // Indirect draws, bound at bindings 1 to 6 of the instance descriptor sets
+        struct DrawFrameBuffers
+        {
+            // Written by the CPU
+            VkBuffer dataBuffer = VK_NULL_HANDLE;
+            MemoryAllocation dataMemory;
+            VkBuffer commandBuffer = VK_NULL_HANDLE;
+            MemoryAllocation commandMemory;
+
+            // Written by the culling pass
+            VkBuffer culledCommandBuffer = VK_NULL_HANDLE;
+            MemoryAllocation culledCommandMemory;
+            VkBuffer culledDrawIndexBuffer = VK_NULL_HANDLE;
+            MemoryAllocation culledDrawIndexMemory;
+            VkBuffer visibleInstanceBuffer = VK_NULL_HANDLE;
+            MemoryAllocation visibleInstanceMemory;
+            VkBuffer countBuffer = VK_NULL_HANDLE;
+            MemoryAllocation countMemory;
+
+            uint32_t capacity = 0;
+            uint32_t visibleInstanceCapacity = 0;
+        };
+
+        struct DrawResources
+        {
+            std::array<DrawFrameBuffers, FRAMES_IN_FLIGHT> frames;
+
+            // Rebuilt every frame, runs index into data and commands. Shadow draws come first, then opaque, then transparent
+            std::vector<DrawData> data;
+            std::vector<VkDrawIndexedIndirectCommand> commands;
+            std::array<std::vector<DrawRun>, SHADOW_CASCADE_COUNT> shadowRuns;
+            std::array<std::vector<DrawRun>, SHADOW_CASCADE_COUNT> staticShadowRuns;
+            std::vector<DrawRun> opaqueRuns;
+            std::vector<DrawRun> transparentRuns;
+
+            // Every cascade gets its own copy of the dynamic shadow draws, and of the static ones while its cache layer is redrawn
+            std::array<DrawRange, SHADOW_CASCADE_COUNT> shadowDrawRanges;
+            DrawRange opaqueDrawRange;
+            uint32_t cullRunCount = 0;
+            uint32_t visibleInstanceCount = 0;
+
+            // Frustum culling scratch, reused across models
+            std::vector<float> instanceScales;
+            SphereList cullingSpheres;
+            std::vector<uint8_t> cullingResults;
+        } drawResources;
+
+        // Point lights, bound at bindings 3 to 5 of the model descriptor sets
+        struct LightFrameBuffers
+        {
+            VkBuffer lightBuffer = VK_NULL_HANDLE;
+            MemoryAllocation lightMemory;
+            VkBuffer clusterBuffer = VK_NULL_HANDLE;
+            MemoryAllocation clusterMemory;
+            VkBuffer lightIndexBuffer = VK_NULL_HANDLE;
+            MemoryAllocation lightIndexMemory;
+
+            uint32_t lightCapacity = 0;
+            uint32_t lightIndexCapacity = 0;
+        };
+
+        struct LightResources
+        {
+            std::array<LightFrameBuffers, FRAMES_IN_FLIGHT> frames;
+
+            // Rebuilt every frame from the emissive instances, the environment's sun is the only shadowed light
+            std::vector<PointLight> pointLights;
+            std::vector<LightCluster> clusters;
+            std::vector<uint32_t> lightIndices;
+
+            // Cluster ranges of each point light, min and max corners inclusive
+            std::vector<std::array<uint32_t, 6>> lightClusterBounds;
+        } lightResources;
+
         // Pipeline 2: Main
         GraphicsPipeline modelPipeline;
 
         std::array<VkBuffer, FRAMES_IN_FLIGHT> cameraUniformBuffer;
-        std::array<VkDeviceMemory, FRAMES_IN_FLIGHT> cameraUniformBufferMemory;
+        std::array<MemoryAllocation, FRAMES_IN_FLIGHT> cameraUniformBufferMemory;
 
         std::array<VkBuffer, FRAMES_IN_FLIGHT> lightingUniformBuffer;
-        std::array<VkDeviceMemory, FRAMES_IN_FLIGHT> lightingUniformBufferMemory;
+        std::array<MemoryAllocation, FRAMES_IN_FLIGHT> lightingUniformBufferMemory;
 
         // Main pass attachments
         std::vector<ImageAttachment> prePostAttachments;
@@ -247,7 +658,7 @@ namespace VE
         GraphicsPipeline uiPipeline;
 
         std::array<VkBuffer, FRAMES_IN_FLIGHT> uiUniformBuffers;
-        std::array<VkDeviceMemory, FRAMES_IN_FLIGHT> uiUniformBuffersMemory;
+        std::array<MemoryAllocation, FRAMES_IN_FLIGHT> uiUniformBuffersMemory;
 
         // Pipeline 5: Post-processing
         GraphicsPipeline postPipeline;
@@ -255,15 +666,196 @@ namespace VE
         VkSampler postSampler = VK_NULL_HANDLE;
 
         // Textures
+        struct TextureCacheEntry
+        {
+            uint32_t texIndex = INVALID_TEXTURE_INDEX;
+            uint32_t refCount = 0;
+
+            // Ready once the batch uploading the texture has been submitted
+            std::shared_future<void> uploaded;
+        };
+
+        // Unreferenced textures and replaced mip chains stay alive until every frame that could sample them has finished
+        struct RetiredTexture
+        {
+            ImageAttachment attachment;
+
+            // Slot handed back once the attachment is destroyed, if the texture was released
+            uint32_t freedIndex = INVALID_TEXTURE_INDEX;
+
+            uint64_t frameIndex = 0;
+        };
+
+        // Mip residency of a cooked texture, the levels above residentLevel are not in memory
+        struct TextureStream
+        {
+            bool isStreamed = false;
+
+            // Also drawn by a widget, which always wants the full resolution
+            bool isPinned = false;
+
+            // The file failed to load, meshes draw their material colour and widgets the fallback texture
+            bool isMissing = false;
+
+            // Size of the largest level, and the bytes of every level from index i down
+            uint32_t size = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            CookedTextureFormat format{};
+            std::vector<VkDeviceSize> mipTailBytes;
+
+            uint32_t residentLevel = 0;
+            uint32_t requestedLevel = UINT32_MAX;
+            uint32_t wantedLevel = 0;
+
+            // Jobs copy from the resident chain, so none starts before the frame after its acquire was recorded
+            uint64_t streamableFrameIndex = UINT64_MAX;
+
+            // Drawn by a model instance this frame, a texture nothing draws yet keeps the levels it loaded with
+            bool isReferenced = false;
+
+            // A new mip chain goes to whichever of the texture's two descriptors frames in flight aren't sampling
+            bool usesSecondDescriptor = false;
+            uint64_t swapFrameIndex = 0;
+
+            // Bumped when the slot is reused, so a job for its previous texture is dropped
+            uint32_t generation = 0;
+        };
+
+        struct StreamedTexture
+        {
+            uint32_t texIndex = INVALID_TEXTURE_INDEX;
+            uint32_t generation = 0;
+            uint32_t firstLevel = 0;
+            ImageAttachment attachment;
+        };
+
+        // A texture file in memory, either stb_image pixels or a cooked mip chain, both empty if it failed to load
+        struct DecodedImage
+        {
+            // RGBA8, freed with stbi_image_free
+            std::shared_ptr<uint8_t> pixels;
+            uint32_t width = 0;
+            uint32_t height = 0;
+
+            std::shared_ptr<CookedTexture> cookedTexture;
+        };
+
         struct TextureResources
         {
+            // Indexed by texIndex, like the descriptor array
             std::vector<ImageAttachment> attachments;
+            std::vector<std::string> filePaths;
             VkSampler sampler = VK_NULL_HANDLE;
+
+            // One array of every texture, indexed by texIndex in the shaders
             VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
-            std::vector<VkDescriptorPool> descriptorPools;
-            std::vector<VkDescriptorSet> descriptorSets;
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+            // Meshes sharing a file path share one texture
+            std::unordered_map<std::string, TextureCacheEntry> cache;
+            std::vector<uint32_t> freeIndices;
+            std::deque<RetiredTexture> retired;
+
+            // Indexed by texIndex
+            std::vector<TextureStream> streams;
+            uint32_t streamingJobCount = 0;
         }textures;
 
+        // Geometry
+        struct GeometryPage
+        {
+            VkBuffer vertexBuffer = VK_NULL_HANDLE;
+            MemoryAllocation vertexBufferMemory;
+            RangeAllocator vertexRanges;
+
+            VkBuffer indexBuffer = VK_NULL_HANDLE;
+            MemoryAllocation indexBufferMemory;
+            RangeAllocator indexRanges;
+        };
+
+        struct GeometryBinding
+        {
+            uint32_t pageIndex = UINT32_MAX;
+            VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+        };
+
+        std::vector<GeometryPage> geometryPages;
+        std::mutex geometryMutex;
+
+        // Upload workers
+        struct UploadWorkerPool
+        {
+            std::vector<std::thread> threads;
+            std::vector<UploadContext> contexts;
+
+            MpmcQueue<UploadJob> jobs{UPLOAD_JOB_QUEUE_CAPACITY};
+            std::counting_semaphore<> jobsAvailable{0};
+            std::atomic<bool> isStopping = false;
+        } uploadWorkers;
+
+        // Decode workers
+        using DecodeJob = std::function<void()>;
+
+        struct DecodeWorkerPool
+        {
+            std::vector<std::thread> threads;
+
+            MpmcQueue<DecodeJob> jobs{DECODE_JOB_QUEUE_CAPACITY};
+            std::counting_semaphore<> jobsAvailable{0};
+            std::atomic<bool> isStopping = false;
+
+            // Prefetched files by path, taken by the upload that creates their texture
+            std::unordered_map<std::string, std::future<DecodedImage>> pending;
+            std::mutex pendingMutex;
+        } decodeWorkers;
+
+        // Finished by the workers, published by the render thread on its next sync
+        struct CompletedUploads
+        {
+            std::vector<ModelBuffer> models;
+            std::vector<WidgetBuffer> widgets;
+            std::vector<StreamedTexture> textures;
+
+            std::mutex mutex;
+        } completedUploads;
+
+        // Render thread only, newest version handed to the workers per handle
+        std::unordered_map<uint64_t, uint64_t> queuedModelVersions;
+        std::unordered_map<uint64_t, uint64_t> queuedWidgetVersions;
+
+        // Staging
+        struct StagingRing
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            MemoryAllocation memory;
+            uint8_t *data = nullptr;
+
+            VkDeviceSize head = 0;
+
+            // Oldest first, retired from the front once the upload timeline passes them
+            std::deque<StagingRegion> regions;
+            std::vector<DedicatedStagingBuffer> dedicatedBuffers;
+
+            std::mutex mutex;
+            std::condition_variable regionSubmitted;
+        } staging;
+
+        // Signalled by every transfer submission, the graphics queue only waits on it for frames that acquire uploads
+        struct UploadTimeline
+        {
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+
+            // Guarded by transferQueueMutex
+            uint64_t submittedValue = 0;
+
+            UploadAcquires pendingAcquires;
+            uint64_t pendingValue = 0;
+
+            std::mutex mutex;
+        } uploadTimeline;
+
         // Synchronization
         std::vector<VkSemaphore> renderFinishedSemaphores;
 
@@ -289,9 +881,16 @@ namespace VE
 
         void createDepthAttachment();
         void createShadowDepthAttachment();
+        void createShadowCascadeViews(VkImage image, std::array<VkImageView, SHADOW_CASCADE_COUNT> &cascadeViews);
 
         void createPipelineCache();
 
+        void createInstanceResources();
+        void createInstanceBuffer(uint32_t currentFrame, uint32_t capacity);
+        void createDrawBuffers(uint32_t currentFrame, uint32_t capacity);
+        void createVisibleInstanceBuffer(uint32_t currentFrame, uint32_t capacity);
+        void writeStorageBufferDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkBuffer buffer);
+
         void createModelUniformBuffers();
         void createPostSampler();
         void createUIUniformBuffers();
@@ -302,6 +901,7 @@ namespace VE
 
         void createModelPipeline();
         void createTransparentPipeline();
+        void createCullPipeline();
         void createShadowPipeline();
 
         void createPostPipeline();
@@ -312,9 +912,25 @@ namespace VE
         void createSyncObjects();
 
         // Runtime
-        void recordShadowPass(const std::vector<Model> &models, const std::vector<ModelInstance> &modelInstances, const glm::mat4 &lightSpaceMat);
-        void updateModelUniformBuffers(uint32_t currentFrame, glm::mat4 projectionMat, glm::mat4 viewMat, glm::vec4 lightPos, glm::vec3 lightColor, glm::mat4 lightSpaceMat, float outdoorBrightness);
-        void recordMainPass(uint32_t currentImage, const std::vector<Model> &models, const std::vector<ModelInstance> &modelInstances, color_t backgroundColor, const glm::mat4 &lightSpaceMat, const glm::vec3 &cameraPosition);
+        void updateInstanceBuffer(uint32_t currentFrame, const std::vector<ModelInstance> &modelInstances);
+        void updateDrawBuffers(uint32_t currentFrame, const glm::vec3 &cameraPosition, const Frustum &frustum, bool hasSun);
+        void appendDrawRun(const MeshBuffer &meshBuffer, const Material *material, const GraphicsPipeline &pipeline, uint32_t firstInstance, uint32_t instanceCount, bool isCulled, std::vector<DrawRun> &runs);
+        void recordCullingPass(const Frustum &cameraFrustum, const ShadowCascades &shadowCascades);
+        void recordDrawRuns(VkCommandBuffer commandBuffer, const std::vector<DrawRun> &runs, VkPipelineLayout layout, uint32_t firstDrawPushOffset);
+        [[nodiscard]] static std::array<glm::vec4, SHADOW_CASCADE_COUNT> fitShadowCascades(const glm::mat4 &projectionMat, const glm::mat4 &viewMat, glm::vec4 &splitDepths);
+        [[nodiscard]] static glm::mat4 computeCascadeMat(const glm::vec4 &cascadeSphere, const glm::vec3 &lightDirection);
+        const ShadowCascades &updateShadowCascades(const glm::mat4 &projectionMat, const glm::mat4 &viewMat, const glm::vec3 &lightDirection, uint64_t staticInstanceVersion);
+        void invalidateStaticShadows();
+        void recordShadowPass(const std::vector<Model> &models, const ShadowCascades &shadowCascades);
+        void recordUnlitShadowMap();
+        void updateModelUniformBuffers(uint32_t currentFrame, glm::mat4 projectionMat, glm::mat4 viewMat, glm::vec4 sunDirection, glm::vec3 sunColor, const ShadowCascades &shadowCascades, const glm::vec4 &clusterParams, float outdoorBrightness);
+        void recordMainPass(uint32_t currentImage, const std::vector<Model> &models, color_t backgroundColor);
+
+        // Lights
+        void createLightResources();
+        void createLightBuffer(uint32_t currentFrame, uint32_t capacity);
+        void createLightIndexBuffer(uint32_t currentFrame, uint32_t capacity);
+        void updateLightClusters(uint32_t currentFrame, const glm::mat4 &projectionMat, const glm::mat4 &viewMat, glm::vec4 &clusterParams);
         void recordPostPass(uint32_t currentImage, const PostEffects& postEffects);
         void updateUIUniformBuffers(uint32_t currentFrame);
         void recordUIPass(uint32_t currentImage, const std::vector<Widget> &widgets, const std::vector<WidgetInstance> &widgetInstances);
@@ -323,34 +939,96 @@ namespace VE
 
         // Helpers
         static void vkCheck(VkResult res, ErrorCode errorCode);
-        void createBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferPropertyFlags, VkBuffer *buffer, VkDeviceMemory *bufferMemory) const;
-        [[nodiscard]] VkResult copyBuffer(VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize, VkFence fence) const;
+        void createBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferPropertyFlags, VkBuffer *buffer, MemoryAllocation *bufferMemory);
         [[nodiscard]] static std::vector<char> readFile(const std::string &fileName);
         [[nodiscard]] VkShaderModule createShaderModule(const std::vector<char> &code) const;
         [[nodiscard]] static uint32_t rateDevice(VkPhysicalDevice device, VkSurfaceKHR surface);
         [[nodiscard]] VkFormat findDepthFormat() const;
-        void destroyImageAttachment(ImageAttachment &attachment) const;
+        void destroyImageAttachment(ImageAttachment &attachment);
+        void destroyBuffer(VkBuffer &buffer, MemoryAllocation &memory);
+
+        // Uploads
+        void createStagingRing();
+        void createUploadTimeline();
+        void waitForUploadTimeline(uint64_t timelineValue);
+        [[nodiscard]] UploadContext createUploadContext();
+        void destroyUploadContext(UploadContext &context);
+        void startUploadWorkers();
+        void runUploadWorker(UploadContext &context);
+        void submitUploadJob(UploadJob job);
+        void stopUploadWorkers();
+        void beginUploadBatch(UploadContext &context, UploadBatch &batch);
+        void beginUploadCommands(UploadBatch &batch);
+        void submitUploadBatch(UploadBatch &batch);
+        void flushUploadBatch(UploadBatch &batch);
+        void endUploadBatch(UploadBatch &batch);
+        void retireStaging();
+        [[nodiscard]] StagingAllocation allocateStaging(UploadBatch &batch, VkDeviceSize size);
+        void uploadBuffer(UploadBatch &batch, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+        void uploadImage(UploadBatch &batch, VkImage dstImage, const void *data, VkDeviceSize size, std::vector<VkBufferImageCopy> imageRegions);
+        void releaseImage(UploadBatch &batch, VkImage image, VkImageLayout layout, uint32_t mipLevelCount);
+        [[nodiscard]] uint64_t recordUploadAcquires(VkCommandBuffer commandBuffer);
+        void destroyStagingRing();
 
         // Models
         void syncModelBuffers(const std::vector<Model> &models);
-        void createVertexBuffer(MeshBuffer &meshBuffer, const std::vector<Vertex> &vertices);
-        void createIndexBuffer(MeshBuffer &meshBuffer, const std::vector<uint32_t> &indices);
-        void initModelBuffer(const Model &model);
-        void updateModelBuffer(ModelBuffer &modelBuffer, const Model &model);
+        void publishModelBuffers(const std::vector<Model> &models);
+        void createMeshGeometry(UploadBatch &batch, MeshBuffer &meshBuffer, const Mesh &mesh, bool allowPacking);
+        [[nodiscard]] ModelBuffer createModelBuffer(UploadContext &context, const Model &model);
+        [[nodiscard]] ModelBuffer *findModelBuffer(ModelHandle handle);
+        void addModelBuffer(ModelBuffer &&modelBuffer);
+        void eraseModelBuffer(uint32_t index);
         void removeOrphanedModel(const std::vector<ModelInstance> &modelInstances);
-        void destroyMeshBuffer(MeshBuffer &meshBuffer) const;
+        void destroyMeshBuffer(MeshBuffer &meshBuffer);
+        void retireMeshBuffers(std::vector<MeshBuffer> &&meshBuffers);
+        void destroyRetiredMeshBuffers();
+
+        // Geometry
+        void allocateGeometry(MeshBuffer &meshBuffer, VkDeviceSize vertexStride, VkDeviceSize vertexBytes, VkDeviceSize indexStride, VkDeviceSize indexBytes);
+        void freeGeometry(MeshBuffer &meshBuffer);
+        void bindGeometry(VkCommandBuffer commandBuffer, uint32_t geometryPageIndex, VkIndexType indexType, GeometryBinding &binding) const;
+        void destroyGeometryPages();
 
         // UI
         void syncWidgetBuffers(const std::vector<Widget> &widgets);
-        void initWidgetBuffer(const Widget &widget);
+        void publishWidgetBuffers(const std::vector<Widget> &widgets);
+        [[nodiscard]] WidgetBuffer *findWidgetBuffer(WidgetHandle handle);
+        [[nodiscard]] WidgetBuffer createWidgetBuffer(UploadContext &context, const Widget &widget);
 
         // Textures
         void createFallbackTexture();
-        void createTextureDescriptorSetLayout();
-        [[nodiscard]] size_t createTextureImage(std::string fileName);
-        [[nodiscard]] size_t createTexture(std::string fileName);
-        [[nodiscard]] size_t createTextureDescriptor(VkImageView textureImageView);
-        [[nodiscard]] VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, uint32_t mipLevelCount, VkDeviceMemory *imageMemory);
+        void createTextureDescriptors();
+        [[nodiscard]] ImageAttachment createTextureImage(UploadBatch &batch, const std::string &fileName, bool allowStreaming, TextureStream &stream);
+        [[nodiscard]] ImageAttachment createCookedTextureImage(UploadBatch &batch, const CookedTexture &cookedTexture, bool allowStreaming, TextureStream &stream);
+        [[nodiscard]] ImageAttachment uploadCookedMipLevels(UploadBatch &batch, const CookedTexture &cookedTexture, uint32_t firstLevel, uint32_t mipLevelCount);
+        [[nodiscard]] VkImageView createTextureView(const ImageAttachment &attachment);
+        [[nodiscard]] uint32_t createTexture(UploadBatch &batch, const std::string &fileName, bool allowStreaming);
+        [[nodiscard]] uint32_t reserveTextureIndex();
+        void releaseTexture(uint32_t texIndex);
+        void destroyRetiredTextures();
+        [[nodiscard]] static bool areTextureUploadsSubmitted(const std::vector<std::shared_future<void>> &textureUploads);
+        static void recordMipmapGeneration(VkCommandBuffer commandBuffer, const MipmapGeneration &mipmapGeneration);
+        void writeTextureDescriptor(uint32_t descriptorIndex, VkImageView textureImageView);
+        [[nodiscard]] uint32_t textureDescriptorIndex(uint32_t texIndex) const;
+
+        // Texture decoding
+        void startDecodeWorkers();
+        void runDecodeWorker();
+        void stopDecodeWorkers();
+        void prefetchTextures(const std::vector<Mesh> &meshes);
+        [[nodiscard]] DecodedImage takeDecodedImage(const std::string &fileName);
+        void discardDecodedImage(const std::string &fileName);
+        [[nodiscard]] std::shared_future<DecodedImage> decodeTextureLevels(const std::string &fileName, uint32_t firstLevel, uint32_t levelCount);
+        void submitDecodeJob(DecodeJob &&job);
+        [[nodiscard]] static DecodedImage decodeImage(const std::string &fileName);
+
+        // Texture streaming
+        void updateTextureStreaming(const std::vector<ModelInstance> &modelInstances, const glm::mat4 &projectionMat, const glm::mat4 &viewMat);
+        void publishStreamedTextures();
+        [[nodiscard]] UploadJob createTextureStreamJob(uint32_t texIndex, uint32_t level);
+        void evictTextureLevels(uint32_t texIndex, uint32_t level);
+        static void recordMipTailCopy(VkCommandBuffer commandBuffer, const MipTailCopy &tailCopy);
+        [[nodiscard]] VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, uint32_t mipLevelCount, uint32_t arrayLayerCount, MemoryAllocation *imageMemory);
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#include "Renderer.hpp"
+
+#include "../../shared/Log.hpp"
+
+#include <algorithm>
+
+namespace VE
+{
+    void Renderer::allocateGeometry(MeshBuffer &meshBuffer, VkDeviceSize vertexStride, VkDeviceSize vertexBytes, VkDeviceSize indexStride, VkDeviceSize indexBytes)
+    {
+        std::lock_guard<std::mutex> lock(geometryMutex);
+
+        // Offsets are aligned to the element size so they convert exactly to vertexOffset and firstIndex
+        VkDeviceSize vertexOffset = 0;
+        VkDeviceSize indexOffset = 0;
+
+        uint32_t pageIndex = 0;
+        for (; pageIndex < geometryPages.size(); pageIndex++)
+        {
+            GeometryPage &page = geometryPages[pageIndex];
+
+            if (!page.vertexRanges.allocate(vertexBytes, vertexStride, &vertexOffset))
+                continue;
+
+            if (page.indexRanges.allocate(indexBytes, indexStride, &indexOffset))
+                break;
+
+            page.vertexRanges.free(vertexOffset, vertexBytes);
+        }
+
+        if (pageIndex == geometryPages.size())
+        {
+            // Meshes bigger than a page get a page of their own size
+            const VkDeviceSize vertexPageSize = std::max(GEOMETRY_VERTEX_PAGE_SIZE, vertexBytes);
+            const VkDeviceSize indexPageSize = std::max(GEOMETRY_INDEX_PAGE_SIZE, indexBytes);
+
+            GeometryPage &page = geometryPages.emplace_back();
+
+            createBuffer(vertexPageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &page.vertexBuffer, &page.vertexBufferMemory);
+            page.vertexRanges.init(vertexPageSize);
+
+            createBuffer(indexPageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &page.indexBuffer, &page.indexBufferMemory);
+            page.indexRanges.init(indexPageSize);
+
+            (void)page.vertexRanges.allocate(vertexBytes, vertexStride, &vertexOffset);
+            (void)page.indexRanges.allocate(indexBytes, indexStride, &indexOffset);
+        }
+
+        meshBuffer.geometryPageIndex = pageIndex;
+        meshBuffer.vertexRange = {vertexOffset, vertexBytes};
+        meshBuffer.indexRange = {indexOffset, indexBytes};
+        meshBuffer.vertexOffset = static_cast<int32_t>(vertexOffset / vertexStride);
+        meshBuffer.firstIndex = static_cast<uint32_t>(indexOffset / indexStride);
+    }
+
+    void Renderer::freeGeometry(MeshBuffer &meshBuffer)
+    {
+        if (meshBuffer.vertexRange.size == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(geometryMutex);
+
+        GeometryPage &page = geometryPages[meshBuffer.geometryPageIndex];
+        page.vertexRanges.free(meshBuffer.vertexRange.offset, meshBuffer.vertexRange.size);
+        page.indexRanges.free(meshBuffer.indexRange.offset, meshBuffer.indexRange.size);
+
+        meshBuffer.vertexRange = {};
+        meshBuffer.indexRange = {};
+    }
+
+    void Renderer::bindGeometry(VkCommandBuffer commandBuffer, uint32_t geometryPageIndex, VkIndexType indexType, GeometryBinding &binding) const
+    {
+        const GeometryPage &page = geometryPages[geometryPageIndex];
+
+        if (geometryPageIndex != binding.pageIndex)
+        {
+            VkBuffer vertexBuffers[] = {page.vertexBuffer};
+            VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        }
+
+        // 16 and 32 bit indices share the page, so only the index type can force a rebind within it
+        if (geometryPageIndex != binding.pageIndex || indexType != binding.indexType)
+            vkCmdBindIndexBuffer(commandBuffer, page.indexBuffer, 0, indexType);
+
+        binding.pageIndex = geometryPageIndex;
+        binding.indexType = indexType;
+    }
+
+    void Renderer::destroyGeometryPages()
+    {
+        for (GeometryPage &page : geometryPages)
+        {
+            if (page.vertexBuffer)
+                vkDestroyBuffer(device, page.vertexBuffer, nullptr);
+            memoryAllocator.free(page.vertexBufferMemory);
+
+            if (page.indexBuffer)
+                vkDestroyBuffer(device, page.indexBuffer, nullptr);
+            memoryAllocator.free(page.indexBufferMemory);
+        }
+
+        geometryPages.clear();
+    }
+}
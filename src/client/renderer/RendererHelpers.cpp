@@ -36,23 +36,6 @@ namespace VE
         }
     }
 
-    uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
-    {
-        VkPhysicalDeviceMemoryProperties memoryProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-
-        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
-        {
-            if ((allowedTypes & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
-            {
-                return i;
-            }
-        }
-
-        Log::add('V', 237);
-        return -1;
-    }
-
     std::vector<char> Renderer::readFile(const std::string &fileName)
     {
         std::ifstream file(fileName, std::ios::binary | std::ios::ate);
@@ -90,92 +73,27 @@ namespace VE
         return shaderModule;
     }
 
-    void Renderer::createBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferPropertyFlags, VkBuffer *buffer, VkDeviceMemory *bufferMemory) const
+    void Renderer::createBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags, VkMemoryPropertyFlags bufferPropertyFlags, VkBuffer *buffer, MemoryAllocation *bufferMemory)
     {
-        std::array<uint32_t, 2> queueFamilyIndices = {graphicsQueueFamilyIndex, transferQueueFamilyIndex};
+        // Uploads hand buffers to the graphics queue with an explicit ownership transfer
         VkBufferCreateInfo bufferCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
             .size = bufferSize,
             .usage = bufferUsageFlags,
-            .sharingMode = VK_SHARING_MODE_CONCURRENT,
-            .queueFamilyIndexCount = 2,
-            .pQueueFamilyIndices = queueFamilyIndices.data()};
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
 
         vkCheck(vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer), {'V', 218});
 
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device, *buffer, &memRequirements);
 
-        VkMemoryAllocateInfo memoryAllocInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .allocationSize = memRequirements.size,
-            .memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memRequirements.memoryTypeBits, bufferPropertyFlags)};
-
-        vkCheck(vkAllocateMemory(device, &memoryAllocInfo, nullptr, bufferMemory), {'V', 218});
+        *bufferMemory = memoryAllocator.allocate(memRequirements, bufferPropertyFlags, MEMORY_RESOURCE_KIND_BUFFER);
 
-        vkCheck(vkBindBufferMemory(device, *buffer, *bufferMemory, 0), {'V', 218});
+        vkCheck(vkBindBufferMemory(device, *buffer, bufferMemory->memory, bufferMemory->offset), {'V', 218});
     }
 
-    VkResult Renderer::copyBuffer(VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize, VkFence fence) const
+    VkImage Renderer::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, uint32_t mipLevelCount, uint32_t arrayLayerCount, MemoryAllocation *imageMemory)
     {
-        VkResult res;
-
-        VkCommandBuffer transferCommandBuffer;
-
-        VkCommandBufferAllocateInfo allocInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            .commandPool = transferCommandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1};
-
-        res = vkAllocateCommandBuffers(device, &allocInfo, &transferCommandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkCommandBufferBeginInfo beginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        };
-
-        res = vkBeginCommandBuffer(transferCommandBuffer, &beginInfo);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkBufferCopy bufferCopyRegion = {
-            .srcOffset = 0,
-            .dstOffset = 0,
-            .size = bufferSize};
-
-        vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
-
-        res = vkEndCommandBuffer(transferCommandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &transferCommandBuffer};
-
-        {
-            std::lock_guard<std::mutex> lock(transferQueueMutex);
-            res = vkQueueSubmit(transferQueue, 1, &submitInfo, fence);
-            if (res != VK_SUCCESS)
-                return res;
-        }
-
-        res = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-        if (res != VK_SUCCESS)
-            return res;
-
-        vkFreeCommandBuffers(device, transferCommandPool, 1, &transferCommandBuffer);
-
-        return VK_SUCCESS;
-    }
-
-    VkImage Renderer::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, uint32_t mipLevelCount, VkDeviceMemory *imageMemory)
-    {
-        std::array<uint32_t, 2> queueFamilyIndices = {graphicsQueueFamilyIndex, transferQueueFamilyIndex};
         VkImageCreateInfo imageCreateInfo = {};
         imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -183,15 +101,13 @@ namespace VE
         imageCreateInfo.extent.height = height;
         imageCreateInfo.extent.depth = 1;
         imageCreateInfo.mipLevels = mipLevelCount;
-        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.arrayLayers = arrayLayerCount;
         imageCreateInfo.format = format;
         imageCreateInfo.tiling = tiling;
         imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         imageCreateInfo.usage = useFlags;
         imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-        imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-        imageCreateInfo.queueFamilyIndexCount = 2;
-        imageCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
         VkImage image;
         vkCheck(vkCreateImage(device, &imageCreateInfo, nullptr, &image), {'V', 222});
@@ -199,13 +115,9 @@ namespace VE
         VkMemoryRequirements memoryRequirements;
         vkGetImageMemoryRequirements(device, image, &memoryRequirements);
 
-        VkMemoryAllocateInfo memoryAllocInfo = {};
-        memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memoryAllocInfo.allocationSize = memoryRequirements.size;
-        memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, propFlags);
+        *imageMemory = memoryAllocator.allocate(memoryRequirements, propFlags, MEMORY_RESOURCE_KIND_IMAGE);
 
-        vkCheck(vkAllocateMemory(device, &memoryAllocInfo, nullptr, imageMemory), {'V', 222});
-        vkBindImageMemory(device, image, *imageMemory, 0);
+        vkCheck(vkBindImageMemory(device, image, imageMemory->memory, imageMemory->offset), {'V', 222});
 
         return image;
     }
@@ -213,9 +125,67 @@ namespace VE
     uint32_t Renderer::rateDevice(VkPhysicalDevice device, VkSurfaceKHR surface)
     {
         VkPhysicalDeviceProperties props;
-        VkPhysicalDeviceFeatures features;
         vkGetPhysicalDeviceProperties(device, &props);
-        vkGetPhysicalDeviceFeatures(device, &features);
+
+        // Dynamic rendering is core from 1.3, and the core feature structs below can't be queried on older devices
+        if (props.apiVersion < VK_API_VERSION_1_3)
+        {
+            Log::add('V', 115);
+            return 0;
+        }
+
+        VkPhysicalDeviceVulkan11Features vulkan11Features{};
+        vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.pNext = &vulkan11Features;
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+
+        const VkPhysicalDeviceFeatures &features = features2.features;
+
+        // Everything createLogicalDevice enables without checking
+        const bool hasRequiredFeatures = features.samplerAnisotropy &&
+                                         features.multiDrawIndirect &&
+                                         features.drawIndirectFirstInstance &&
+                                         vulkan11Features.shaderDrawParameters &&
+                                         vulkan12Features.drawIndirectCount &&
+                                         vulkan12Features.runtimeDescriptorArray &&
+                                         vulkan12Features.descriptorBindingPartiallyBound &&
+                                         vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+                                         vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+                                         vulkan12Features.shaderSampledImageArrayNonUniformIndexing &&
+                                         vulkan12Features.timelineSemaphore;
+
+        if (!hasRequiredFeatures)
+        {
+            Log::add('V', 115);
+            return 0;
+        }
+
+        VkPhysicalDeviceVulkan12Properties vulkan12Props{};
+        vulkan12Props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 props2{};
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props2.pNext = &vulkan12Props;
+        vkGetPhysicalDeviceProperties2(device, &props2);
+
+        // Every texture has two descriptors in the bindless array
+
+        const uint32_t textureDescriptorCount = 2 * MAX_TEXTURE_COUNT;
+        if (vulkan12Props.maxPerStageDescriptorUpdateAfterBindSamplers < textureDescriptorCount ||
+            vulkan12Props.maxPerStageDescriptorUpdateAfterBindSampledImages < textureDescriptorCount ||
+            vulkan12Props.maxDescriptorSetUpdateAfterBindSamplers < textureDescriptorCount ||
+            vulkan12Props.maxDescriptorSetUpdateAfterBindSampledImages < textureDescriptorCount)
+        {
+            Log::add('V', 115);
+            return 0;
+        }
 
         int score = 0;
 
@@ -224,9 +194,6 @@ namespace VE
 
         score += props.limits.maxImageDimension2D;
 
-        if (!features.samplerAnisotropy)
-            return 0;
-
         uint32_t queueFamilyCount = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
         std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
@@ -283,13 +250,21 @@ namespace VE
         return format;
     }
 
-    void Renderer::destroyImageAttachment(ImageAttachment &attachment) const
+    void Renderer::destroyImageAttachment(ImageAttachment &attachment)
     {
         if (attachment.imageView)
             vkDestroyImageView(device, attachment.imageView, nullptr);
         if (attachment.image)
             vkDestroyImage(device, attachment.image, nullptr);
-        if (attachment.memory)
-            vkFreeMemory(device, attachment.memory, nullptr);
+        memoryAllocator.free(attachment.memory);
+    }
+
+    void Renderer::destroyBuffer(VkBuffer &buffer, MemoryAllocation &memory)
+    {
+        if (buffer)
+            vkDestroyBuffer(device, buffer, nullptr);
+        memoryAllocator.free(memory);
+
+        buffer = VK_NULL_HANDLE;
     }
 }
\ No newline at end of file
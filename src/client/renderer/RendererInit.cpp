@@ -20,9 +20,14 @@ namespace VE
         pickPhysicalDevice();
         createLogicalDevice();
 
+        memoryAllocator.init(physicalDevice, device);
+
         createCommandPool();
         createCommandBuffers();
 
+        createStagingRing();
+        createUploadTimeline();
+
         createSwapChain(windowSize);
 
         createPrePostImages();
@@ -32,16 +37,19 @@ namespace VE
         createPipelineCache();
 
         createTextureSampler();
-        createTextureDescriptorSetLayout();
+        createTextureDescriptors();
         createFallbackTexture();
 
         createShadowDepthAttachment();
+        createInstanceResources();
+        createCullPipeline();
         createShadowPipeline();
         
         createDepthAttachment();
         createShadowSampler();
         createModelUniformBuffers();
         createModelDescriptors();
+        createLightResources();
         createModelPipeline();
 
         createTransparentPipeline();
@@ -56,6 +64,9 @@ namespace VE
 
         createSyncObjects();
 
+        startDecodeWorkers();
+        startUploadWorkers();
+
         Log::add('V', 000);
     }
 
@@ -182,11 +193,36 @@ namespace VE
         }
 
         const char *swapChainExtention = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+        // Cooked BC textures fall back to the white texture where it's missing
         VkPhysicalDeviceFeatures deviceFeatures = {
-            .samplerAnisotropy = VK_TRUE};
+            .multiDrawIndirect = VK_TRUE,
+            .drawIndirectFirstInstance = VK_TRUE,
+            .samplerAnisotropy = VK_TRUE,
+            .textureCompressionBC = supportedFeatures.textureCompressionBC};
+
+        // gl_DrawID in the model and shadow shaders
+        VkPhysicalDeviceVulkan11Features vulkan11Features{};
+        vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        vulkan11Features.shaderDrawParameters = VK_TRUE;
+
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.pNext = &vulkan11Features;
+        vulkan12Features.drawIndirectCount = VK_TRUE;
+        vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
 
         VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
         dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+        dynamicRenderingFeatures.pNext = &vulkan12Features;
         dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
 
         VkDeviceCreateInfo deviceCreateInfo = {
@@ -289,7 +325,7 @@ namespace VE
         prePostAttachments.resize(swapChainImageCount);
         for (ImageAttachment &attachment : prePostAttachments)
         {
-            attachment.image = createImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SHARING_MODE_EXCLUSIVE, 1, &attachment.memory);
+            attachment.image = createImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SHARING_MODE_EXCLUSIVE, 1, 1, &attachment.memory);
 
             VkImageViewCreateInfo imageViewCreateInfo{};
             imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -311,7 +347,7 @@ namespace VE
 
     void Renderer::createDepthAttachment()
     {
-        depthAttachment.image = createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, &depthAttachment.memory);
+        depthAttachment.image = createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, 1, &depthAttachment.memory);
 
         VkImageViewCreateInfo imageViewCreateInfo{};
         imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -332,12 +368,12 @@ namespace VE
 
     void Renderer::createShadowDepthAttachment()
     {
-        shadowDepthAttachment.image = createImage(SHADOW_MAP_EXTENT.w, SHADOW_MAP_EXTENT.h, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, &shadowDepthAttachment.memory);
+        shadowDepthAttachment.image = createImage(SHADOW_MAP_EXTENT.w, SHADOW_MAP_EXTENT.h, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, SHADOW_CASCADE_COUNT, &shadowDepthAttachment.memory);
 
         VkImageViewCreateInfo imageViewCreateInfo{};
         imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         imageViewCreateInfo.image = shadowDepthAttachment.image;
-        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
         imageViewCreateInfo.format = depthFormat;
         imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -347,8 +383,38 @@ namespace VE
         imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
         imageViewCreateInfo.subresourceRange.levelCount = 1;
         imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        imageViewCreateInfo.subresourceRange.layerCount = 1;
+        imageViewCreateInfo.subresourceRange.layerCount = SHADOW_CASCADE_COUNT;
         vkCheck(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &shadowDepthAttachment.imageView), {'V', 205});
+
+        createShadowCascadeViews(shadowDepthAttachment.image, shadowCascadeViews);
+
+        // Only ever rendered into and copied from, so it needs no sampled view
+        shadowCache.staticAttachment.image = createImage(SHADOW_MAP_EXTENT.w, SHADOW_MAP_EXTENT.h, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, SHADOW_CASCADE_COUNT, &shadowCache.staticAttachment.memory);
+
+        createShadowCascadeViews(shadowCache.staticAttachment.image, shadowCache.staticCascadeViews);
+    }
+
+    void Renderer::createShadowCascadeViews(VkImage image, std::array<VkImageView, SHADOW_CASCADE_COUNT> &cascadeViews)
+    {
+        VkImageViewCreateInfo imageViewCreateInfo{};
+        imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewCreateInfo.image = image;
+        imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewCreateInfo.format = depthFormat;
+        imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+        imageViewCreateInfo.subresourceRange.levelCount = 1;
+        imageViewCreateInfo.subresourceRange.layerCount = 1;
+
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+        {
+            imageViewCreateInfo.subresourceRange.baseArrayLayer = i;
+            vkCheck(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &cascadeViews[i]), {'V', 205});
+        }
     }
 
     void Renderer::createSyncObjects()
@@ -372,26 +438,20 @@ namespace VE
         }
     }
 
-    void Renderer::destroyMeshBuffer(MeshBuffer &meshBuffer) const
+    void Renderer::destroyMeshBuffer(MeshBuffer &meshBuffer)
     {
-        if (meshBuffer.vertexBuffer)
-            vkDestroyBuffer(device, meshBuffer.vertexBuffer, nullptr);
-        if (meshBuffer.vertexBufferMemory)
-            vkFreeMemory(device, meshBuffer.vertexBufferMemory, nullptr);
-
-        if (meshBuffer.indexBuffer)
-            vkDestroyBuffer(device, meshBuffer.indexBuffer, nullptr);
-        if (meshBuffer.indexBufferMemory)
-            vkFreeMemory(device, meshBuffer.indexBufferMemory, nullptr);
-
-        meshBuffer.vertexBuffer = VK_NULL_HANDLE;
-        meshBuffer.vertexBufferMemory = VK_NULL_HANDLE;
-        meshBuffer.indexBuffer = VK_NULL_HANDLE;
-        meshBuffer.indexBufferMemory = VK_NULL_HANDLE;
+        freeGeometry(meshBuffer);
+
+        releaseTexture(meshBuffer.texIndex);
+        meshBuffer.texIndex = INVALID_TEXTURE_INDEX;
     }
 
     Renderer::~Renderer()
     {
+        // Upload workers may be waiting on a decode, so they are stopped first
+        stopUploadWorkers();
+        stopDecodeWorkers();
+
         if (device != VK_NULL_HANDLE)
             vkCheck(vkDeviceWaitIdle(device), {'V', 235});
 
@@ -400,22 +460,17 @@ namespace VE
         std::vector<char> outPipelineCacheData(pipelineCacheSize);
         vkGetPipelineCacheData(device, pipelineCache, &pipelineCacheSize, outPipelineCacheData.data());
         vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
+        destroyStagingRing();
+        if (uploadTimeline.semaphore)
+            vkDestroySemaphore(device, uploadTimeline.semaphore, nullptr);
+
         std::ofstream file(PIPELINE_CACHE_FILE_NAME, std::ios::binary | std::ios::trunc);
         if (!file.is_open())
             Log::add('V', 110);
         else
             file.write(outPipelineCacheData.data(), static_cast<std::streamsize>(pipelineCacheSize));
 
-        if (textures.sampler)
-            vkDestroySampler(device, textures.sampler, nullptr);
-        if (textures.descriptorSetLayout)
-            vkDestroyDescriptorSetLayout(device, textures.descriptorSetLayout, nullptr);
-        for (ImageAttachment &attachment : textures.attachments)
-            destroyImageAttachment(attachment);
-        for (VkDescriptorPool pool : textures.descriptorPools)
-            if (pool)
-                vkDestroyDescriptorPool(device, pool, nullptr);
-
         for (ModelBuffer &modelBuffer : modelBuffers)
             for (MeshBuffer &meshBuffer : modelBuffer.meshBuffers)
                 destroyMeshBuffer(meshBuffer);
@@ -424,6 +479,26 @@ namespace VE
             for (MeshBuffer &meshBuffer : widgetBuffer.meshBuffers)
                 destroyMeshBuffer(meshBuffer);
 
+        for (RetiredMeshBuffers &retired : retiredMeshBuffers)
+            for (MeshBuffer &meshBuffer : retired.meshBuffers)
+                destroyMeshBuffer(meshBuffer);
+
+        destroyGeometryPages();
+
+        // After the meshes, whose textures are released to the retired list on destruction
+        if (textures.sampler)
+            vkDestroySampler(device, textures.sampler, nullptr);
+        if (textures.descriptorSetLayout)
+            vkDestroyDescriptorSetLayout(device, textures.descriptorSetLayout, nullptr);
+        for (ImageAttachment &attachment : textures.attachments)
+            destroyImageAttachment(attachment);
+        for (RetiredTexture &retired : textures.retired)
+            destroyImageAttachment(retired.attachment);
+        for (StreamedTexture &streamed : completedUploads.textures)
+            destroyImageAttachment(streamed.attachment);
+        if (textures.descriptorPool)
+            vkDestroyDescriptorPool(device, textures.descriptorPool, nullptr);
+
         for (FrameData &frame : frames)
         {
             if (frame.imageAvailableSemaphore)
@@ -441,6 +516,8 @@ namespace VE
                 vkDestroyDescriptorPool(device, pipeline.descriptorPool, nullptr);
             if (pipeline.pipeline)
                 vkDestroyPipeline(device, pipeline.pipeline, nullptr);
+            if (pipeline.packedPipeline)
+                vkDestroyPipeline(device, pipeline.packedPipeline, nullptr);
             if (pipeline.layout)
                 vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
             if (pipeline.descriptorSetLayout)
@@ -455,8 +532,7 @@ namespace VE
         {
             if (uiUniformBuffers[i])
                 vkDestroyBuffer(device, uiUniformBuffers[i], nullptr);
-            if (uiUniformBuffersMemory[i])
-                vkFreeMemory(device, uiUniformBuffersMemory[i], nullptr);
+            memoryAllocator.free(uiUniformBuffersMemory[i]);
         }
         destroyGraphicsPipeline(uiPipeline);
 
@@ -464,19 +540,52 @@ namespace VE
         {
             if (cameraUniformBuffer[i])
                 vkDestroyBuffer(device, cameraUniformBuffer[i], nullptr);
-            if (cameraUniformBufferMemory[i])
-                vkFreeMemory(device, cameraUniformBufferMemory[i], nullptr);
+            memoryAllocator.free(cameraUniformBufferMemory[i]);
 
             if (lightingUniformBuffer[i])
                 vkDestroyBuffer(device, lightingUniformBuffer[i], nullptr);
-            if (lightingUniformBufferMemory[i])
-                vkFreeMemory(device, lightingUniformBufferMemory[i], nullptr);
+            memoryAllocator.free(lightingUniformBufferMemory[i]);
         }
         destroyGraphicsPipeline(transparentPipeline);
         destroyGraphicsPipeline(modelPipeline);
 
         destroyGraphicsPipeline(shadowPipeline);
 
+        if (cullPipeline.pipeline)
+            vkDestroyPipeline(device, cullPipeline.pipeline, nullptr);
+        if (cullPipeline.layout)
+            vkDestroyPipelineLayout(device, cullPipeline.layout, nullptr);
+
+        for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+        {
+            destroyBuffer(instanceResources.buffers[i], instanceResources.memories[i]);
+
+            DrawFrameBuffers &drawBuffers = drawResources.frames[i];
+            destroyBuffer(drawBuffers.dataBuffer, drawBuffers.dataMemory);
+            destroyBuffer(drawBuffers.commandBuffer, drawBuffers.commandMemory);
+            destroyBuffer(drawBuffers.culledCommandBuffer, drawBuffers.culledCommandMemory);
+            destroyBuffer(drawBuffers.culledDrawIndexBuffer, drawBuffers.culledDrawIndexMemory);
+            destroyBuffer(drawBuffers.visibleInstanceBuffer, drawBuffers.visibleInstanceMemory);
+            destroyBuffer(drawBuffers.countBuffer, drawBuffers.countMemory);
+
+            LightFrameBuffers &lightBuffers = lightResources.frames[i];
+            destroyBuffer(lightBuffers.lightBuffer, lightBuffers.lightMemory);
+            destroyBuffer(lightBuffers.clusterBuffer, lightBuffers.clusterMemory);
+            destroyBuffer(lightBuffers.lightIndexBuffer, lightBuffers.lightIndexMemory);
+        }
+        if (instanceResources.descriptorPool)
+            vkDestroyDescriptorPool(device, instanceResources.descriptorPool, nullptr);
+        if (instanceResources.descriptorSetLayout)
+            vkDestroyDescriptorSetLayout(device, instanceResources.descriptorSetLayout, nullptr);
+
+        for (VkImageView cascadeView : shadowCache.staticCascadeViews)
+            if (cascadeView)
+                vkDestroyImageView(device, cascadeView, nullptr);
+        destroyImageAttachment(shadowCache.staticAttachment);
+
+        for (VkImageView cascadeView : shadowCascadeViews)
+            if (cascadeView)
+                vkDestroyImageView(device, cascadeView, nullptr);
         destroyImageAttachment(shadowDepthAttachment);
 
         destroyImageAttachment(depthAttachment);
@@ -498,6 +607,8 @@ namespace VE
         if (commandPool)
             vkDestroyCommandPool(device, commandPool, nullptr);
 
+        memoryAllocator.destroy();
+
         if (device)
             vkDestroyDevice(device, nullptr);
 
@@ -7,6 +7,136 @@
 
 namespace VE
 {
+    void Renderer::createInstanceResources()
+    {
+        // Layout, the culling pass reads and writes everything, the vertex and fragment stages only what they draw from
+        constexpr VkShaderStageFlags drawStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 7> layoutBindings;
+        for (uint32_t binding = 0; binding < layoutBindings.size(); binding++)
+            layoutBindings[binding] = {
+                .binding = binding,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr};
+
+        layoutBindings[0].stageFlags = drawStages;                                // Instances
+        layoutBindings[1].stageFlags = drawStages | VK_SHADER_STAGE_FRAGMENT_BIT; // Draw data
+        layoutBindings[4].stageFlags = drawStages;                                // Culled draw indices
+        layoutBindings[5].stageFlags = drawStages;                                // Visible instances
+
+        VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = static_cast<uint32_t>(layoutBindings.size()),
+            .pBindings = layoutBindings.data()};
+
+        vkCheck(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &instanceResources.descriptorSetLayout), {'V', 217});
+
+        // Pool
+        VkDescriptorPoolSize poolSize = {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = static_cast<uint32_t>(layoutBindings.size()) * FRAMES_IN_FLIGHT};
+
+        VkDescriptorPoolCreateInfo poolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = FRAMES_IN_FLIGHT,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize};
+
+        vkCheck(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &instanceResources.descriptorPool), {'V', 219});
+
+        // Sets
+        instanceResources.descriptorSets.resize(FRAMES_IN_FLIGHT);
+
+        std::vector<VkDescriptorSetLayout> setLayouts(FRAMES_IN_FLIGHT, instanceResources.descriptorSetLayout);
+
+        VkDescriptorSetAllocateInfo setAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = instanceResources.descriptorPool,
+            .descriptorSetCount = FRAMES_IN_FLIGHT,
+            .pSetLayouts = setLayouts.data()};
+
+        vkCheck(vkAllocateDescriptorSets(device, &setAllocInfo, instanceResources.descriptorSets.data()), {'V', 220});
+
+        for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+        {
+            createInstanceBuffer(i, INSTANCE_BUFFER_INITIAL_CAPACITY);
+            createDrawBuffers(i, DRAW_BUFFER_INITIAL_CAPACITY);
+            createVisibleInstanceBuffer(i, VISIBLE_INSTANCE_BUFFER_INITIAL_CAPACITY);
+        }
+    }
+
+    void Renderer::createInstanceBuffer(uint32_t currentFrame, uint32_t capacity)
+    {
+        VkBuffer &buffer = instanceResources.buffers[currentFrame];
+        MemoryAllocation &memory = instanceResources.memories[currentFrame];
+
+        destroyBuffer(buffer, memory);
+
+        createBuffer(capacity * sizeof(InstanceData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, &memory);
+        instanceResources.capacities[currentFrame] = capacity;
+
+        writeStorageBufferDescriptor(instanceResources.descriptorSets[currentFrame], 0, buffer);
+    }
+
+    void Renderer::createDrawBuffers(uint32_t currentFrame, uint32_t capacity)
+    {
+        DrawFrameBuffers &drawBuffers = drawResources.frames[currentFrame];
+
+        destroyBuffer(drawBuffers.dataBuffer, drawBuffers.dataMemory);
+        destroyBuffer(drawBuffers.commandBuffer, drawBuffers.commandMemory);
+        destroyBuffer(drawBuffers.culledCommandBuffer, drawBuffers.culledCommandMemory);
+        destroyBuffer(drawBuffers.culledDrawIndexBuffer, drawBuffers.culledDrawIndexMemory);
+        destroyBuffer(drawBuffers.countBuffer, drawBuffers.countMemory);
+
+        // Every run holds at least one draw, so the draw capacity also bounds the run counts
+        createBuffer(capacity * sizeof(DrawData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &drawBuffers.dataBuffer, &drawBuffers.dataMemory);
+        createBuffer(capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &drawBuffers.commandBuffer, &drawBuffers.commandMemory);
+        createBuffer(capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawBuffers.culledCommandBuffer, &drawBuffers.culledCommandMemory);
+        createBuffer(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawBuffers.culledDrawIndexBuffer, &drawBuffers.culledDrawIndexMemory);
+        createBuffer(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawBuffers.countBuffer, &drawBuffers.countMemory);
+        drawBuffers.capacity = capacity;
+
+        const VkDescriptorSet descriptorSet = instanceResources.descriptorSets[currentFrame];
+        writeStorageBufferDescriptor(descriptorSet, 1, drawBuffers.dataBuffer);
+        writeStorageBufferDescriptor(descriptorSet, 2, drawBuffers.commandBuffer);
+        writeStorageBufferDescriptor(descriptorSet, 3, drawBuffers.culledCommandBuffer);
+        writeStorageBufferDescriptor(descriptorSet, 4, drawBuffers.culledDrawIndexBuffer);
+        writeStorageBufferDescriptor(descriptorSet, 6, drawBuffers.countBuffer);
+    }
+
+    void Renderer::createVisibleInstanceBuffer(uint32_t currentFrame, uint32_t capacity)
+    {
+        DrawFrameBuffers &drawBuffers = drawResources.frames[currentFrame];
+
+        destroyBuffer(drawBuffers.visibleInstanceBuffer, drawBuffers.visibleInstanceMemory);
+
+        createBuffer(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &drawBuffers.visibleInstanceBuffer, &drawBuffers.visibleInstanceMemory);
+        drawBuffers.visibleInstanceCapacity = capacity;
+
+        writeStorageBufferDescriptor(instanceResources.descriptorSets[currentFrame], 5, drawBuffers.visibleInstanceBuffer);
+    }
+
+    void Renderer::writeStorageBufferDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkBuffer buffer)
+    {
+        VkDescriptorBufferInfo bufferInfo = {
+            .buffer = buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE};
+
+        VkWriteDescriptorSet setWrite = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfo};
+
+        vkUpdateDescriptorSets(device, 1, &setWrite, 0, nullptr);
+    }
+
     void Renderer::createModelUniformBuffers()
     {
         VkDeviceSize cameraBufferSize = sizeof(UboCamera);
@@ -60,7 +190,15 @@ namespace VE
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             .pImmutableSamplers = nullptr};
 
-        std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings = {cameraLayoutBinding, lightingLayoutBinding, shadowLayoutBinding};
+        // Point lights, light clusters and the clusters' light indices
+        std::array<VkDescriptorSetLayoutBinding, 6> layoutBindings = {cameraLayoutBinding, lightingLayoutBinding, shadowLayoutBinding};
+        for (uint32_t binding = 3; binding < layoutBindings.size(); binding++)
+            layoutBindings[binding] = {
+                .binding = binding,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+                .pImmutableSamplers = nullptr};
 
         VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -78,7 +216,11 @@ namespace VE
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
             .descriptorCount = FRAMES_IN_FLIGHT};
 
-        std::array<VkDescriptorPoolSize, 2> descriptorPoolSizes = {uniformPoolSize, shadowPoolSize};
+        VkDescriptorPoolSize lightPoolSize = {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 3 * FRAMES_IN_FLIGHT};
+
+        std::array<VkDescriptorPoolSize, 3> descriptorPoolSizes = {uniformPoolSize, shadowPoolSize, lightPoolSize};
 
         VkDescriptorPoolCreateInfo poolCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
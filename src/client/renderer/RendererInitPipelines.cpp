@@ -12,6 +12,56 @@ namespace VE
         .stride = sizeof(Vertex),
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
 
+    constexpr VkVertexInputBindingDescription PACKED_BINDING_DESCRIPTION = {
+        .binding = 0,
+        .stride = sizeof(PackedVertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+
+    constexpr std::array<VkVertexInputAttributeDescription, 3> PACKED_ATTRIBUTE_DESCRIPTIONS = {{
+        {0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedVertex, pos)},
+        {1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, tex)},
+        {2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, norm)}}};
+
+    constexpr VkPipelineVertexInputStateCreateInfo PACKED_VERTEX_INPUT_CREATE_INFO = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &PACKED_BINDING_DESCRIPTION,
+        .vertexAttributeDescriptionCount = static_cast<uint32_t>(PACKED_ATTRIBUTE_DESCRIPTIONS.size()),
+        .pVertexAttributeDescriptions = PACKED_ATTRIBUTE_DESCRIPTIONS.data()};
+
+    // shader.vert constant_id 0 switches to octahedral normal decoding, constant_id 1 to draws compacted by the culling pass
+    struct VertexSpecialization
+    {
+        VkBool32 packedVertex;
+        VkBool32 culledDraws;
+    };
+
+    constexpr std::array<VkSpecializationMapEntry, 2> VERTEX_SPECIALIZATION_ENTRIES = {{
+        {0, offsetof(VertexSpecialization, packedVertex), sizeof(VkBool32)},
+        {1, offsetof(VertexSpecialization, culledDraws), sizeof(VkBool32)}}};
+
+    constexpr VertexSpecialization PACKED_VERTEX_SPECIALIZATION_VALUE = {VK_TRUE, VK_FALSE};
+    constexpr VertexSpecialization CULLED_VERTEX_SPECIALIZATION_VALUE = {VK_FALSE, VK_TRUE};
+    constexpr VertexSpecialization PACKED_CULLED_VERTEX_SPECIALIZATION_VALUE = {VK_TRUE, VK_TRUE};
+
+    constexpr VkSpecializationInfo PACKED_VERTEX_SPECIALIZATION_INFO = {
+        .mapEntryCount = static_cast<uint32_t>(VERTEX_SPECIALIZATION_ENTRIES.size()),
+        .pMapEntries = VERTEX_SPECIALIZATION_ENTRIES.data(),
+        .dataSize = sizeof(VertexSpecialization),
+        .pData = &PACKED_VERTEX_SPECIALIZATION_VALUE};
+
+    constexpr VkSpecializationInfo CULLED_VERTEX_SPECIALIZATION_INFO = {
+        .mapEntryCount = static_cast<uint32_t>(VERTEX_SPECIALIZATION_ENTRIES.size()),
+        .pMapEntries = VERTEX_SPECIALIZATION_ENTRIES.data(),
+        .dataSize = sizeof(VertexSpecialization),
+        .pData = &CULLED_VERTEX_SPECIALIZATION_VALUE};
+
+    constexpr VkSpecializationInfo PACKED_CULLED_VERTEX_SPECIALIZATION_INFO = {
+        .mapEntryCount = static_cast<uint32_t>(VERTEX_SPECIALIZATION_ENTRIES.size()),
+        .pMapEntries = VERTEX_SPECIALIZATION_ENTRIES.data(),
+        .dataSize = sizeof(VertexSpecialization),
+        .pData = &PACKED_CULLED_VERTEX_SPECIALIZATION_VALUE};
+
     constexpr VkPipelineInputAssemblyStateCreateInfo DEFAULT_INPUT_ASSEMBLY_CREATE_INFO = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
         .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
@@ -59,7 +109,8 @@ namespace VE
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
             .module = vertexShaderModule,
-            .pName = "main"};
+            .pName = "main",
+            .pSpecializationInfo = &CULLED_VERTEX_SPECIALIZATION_INFO};
 
         VkPipelineShaderStageCreateInfo fragmentShaderStage = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -119,25 +170,19 @@ namespace VE
             .attachmentCount = 1,
             .pAttachments = &colorState};
 
-        std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = {modelPipeline.descriptorSetLayout, textures.descriptorSetLayout};
+        std::array<VkDescriptorSetLayout, 3> descriptorSetLayouts = {modelPipeline.descriptorSetLayout, textures.descriptorSetLayout, instanceResources.descriptorSetLayout};
 
         VkPushConstantRange vertexPushConstantRange;
         vertexPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         vertexPushConstantRange.offset = 0;
         vertexPushConstantRange.size = sizeof(VertexPushData);
-        VkPushConstantRange materialPushConstantRange;
-        materialPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        materialPushConstantRange.offset = materialPushDataStructOffset;
-        materialPushConstantRange.size = sizeof(MaterialPushData);
-
-        std::array<VkPushConstantRange, 2> pushConstantRanges = {vertexPushConstantRange, materialPushConstantRange};
 
         VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
             .pSetLayouts = descriptorSetLayouts.data(),
-            .pushConstantRangeCount = pushConstantRanges.size(),
-            .pPushConstantRanges = pushConstantRanges.data()};
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &vertexPushConstantRange};
 
         vkCheck(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &modelPipeline.layout), {'V', 210});
 
@@ -176,6 +221,11 @@ namespace VE
 
         vkCheck(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &modelPipeline.pipeline), {'V', 211});
 
+        shaderStages[0].pSpecializationInfo = &PACKED_CULLED_VERTEX_SPECIALIZATION_INFO;
+        pipelineCreateInfo.pVertexInputState = &PACKED_VERTEX_INPUT_CREATE_INFO;
+
+        vkCheck(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &modelPipeline.packedPipeline), {'V', 211});
+
         vkDestroyShaderModule(device, vertexShaderModule, nullptr);
         vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
     }
@@ -249,25 +299,19 @@ namespace VE
             .attachmentCount = 1,
             .pAttachments = &colorState};
 
-        std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = {modelPipeline.descriptorSetLayout, textures.descriptorSetLayout};
+        std::array<VkDescriptorSetLayout, 3> descriptorSetLayouts = {modelPipeline.descriptorSetLayout, textures.descriptorSetLayout, instanceResources.descriptorSetLayout};
 
         VkPushConstantRange vertexPushConstantRange;
         vertexPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         vertexPushConstantRange.offset = 0;
         vertexPushConstantRange.size = sizeof(VertexPushData);
-        VkPushConstantRange materialPushConstantRange;
-        materialPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        materialPushConstantRange.offset = materialPushDataStructOffset;
-        materialPushConstantRange.size = sizeof(MaterialPushData);
-
-        std::array<VkPushConstantRange, 2> pushConstantRanges = {vertexPushConstantRange, materialPushConstantRange};
 
         VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
             .pSetLayouts = descriptorSetLayouts.data(),
-            .pushConstantRangeCount = pushConstantRanges.size(),
-            .pPushConstantRanges = pushConstantRanges.data()};
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &vertexPushConstantRange};
 
         vkCheck(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &transparentPipeline.layout), {'V', 210});
 
@@ -306,10 +350,42 @@ namespace VE
 
         vkCheck(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &transparentPipeline.pipeline), {'V', 211});
 
+        shaderStages[0].pSpecializationInfo = &PACKED_VERTEX_SPECIALIZATION_INFO;
+        pipelineCreateInfo.pVertexInputState = &PACKED_VERTEX_INPUT_CREATE_INFO;
+
+        vkCheck(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &transparentPipeline.packedPipeline), {'V', 211});
+
         vkDestroyShaderModule(device, vertexShaderModule, nullptr);
         vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
     }
 
+    void Renderer::createCullPipeline()
+    {
+        VkShaderModule computeShaderModule = createShaderModule(readFile("shaders/cullComp.spv"));
+
+        VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushData)};
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &instanceResources.descriptorSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange};
+        vkCheck(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &cullPipeline.layout), {'V', 210});
+
+        VkComputePipelineCreateInfo pipelineCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = computeShaderModule,
+                .pName = "main"},
+            .layout = cullPipeline.layout};
+
+        vkCheck(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &cullPipeline.pipeline), {'V', 211});
+
+        vkDestroyShaderModule(device, computeShaderModule, nullptr);
+    }
+
     void Renderer::createShadowPipeline()
     {
         VkShaderModule vertexShaderModule = createShaderModule(readFile("shaders/shadowVert.spv"));
@@ -369,8 +445,8 @@ namespace VE
         VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushData)};
         VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
+            .setLayoutCount = 1,
+            .pSetLayouts = &instanceResources.descriptorSetLayout,
             .pushConstantRangeCount = 1,
             .pPushConstantRanges = &pushConstantRange};
         vkCheck(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &shadowPipeline.layout), {'V', 210});
@@ -398,6 +474,19 @@ namespace VE
             .subpass = 0};
         vkCheck(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &shadowPipeline.pipeline), {'V', 211});
 
+        VkVertexInputAttributeDescription packedAttribute = PACKED_ATTRIBUTE_DESCRIPTIONS[0];
+
+        VkPipelineVertexInputStateCreateInfo packedVertexInputStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount = 1,
+            .pVertexBindingDescriptions = &PACKED_BINDING_DESCRIPTION,
+            .vertexAttributeDescriptionCount = 1,
+            .pVertexAttributeDescriptions = &packedAttribute};
+
+        pipelineCreateInfo.pVertexInputState = &packedVertexInputStateCreateInfo;
+
+        vkCheck(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &shadowPipeline.packedPipeline), {'V', 211});
+
         vkDestroyShaderModule(device, vertexShaderModule, nullptr);
     }
 
@@ -0,0 +1,153 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#include "Renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace VE
+{
+    void Renderer::createLightResources()
+    {
+        for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+        {
+            LightFrameBuffers &lightBuffers = lightResources.frames[i];
+
+            createBuffer(LIGHT_CLUSTER_COUNT * sizeof(LightCluster), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &lightBuffers.clusterBuffer, &lightBuffers.clusterMemory);
+            writeStorageBufferDescriptor(modelPipeline.descriptorSets[i], 4, lightBuffers.clusterBuffer);
+
+            createLightBuffer(i, LIGHT_BUFFER_INITIAL_CAPACITY);
+            createLightIndexBuffer(i, LIGHT_INDEX_BUFFER_INITIAL_CAPACITY);
+        }
+    }
+
+    void Renderer::createLightBuffer(uint32_t currentFrame, uint32_t capacity)
+    {
+        LightFrameBuffers &lightBuffers = lightResources.frames[currentFrame];
+
+        destroyBuffer(lightBuffers.lightBuffer, lightBuffers.lightMemory);
+
+        createBuffer(capacity * sizeof(PointLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &lightBuffers.lightBuffer, &lightBuffers.lightMemory);
+        lightBuffers.lightCapacity = capacity;
+
+        writeStorageBufferDescriptor(modelPipeline.descriptorSets[currentFrame], 3, lightBuffers.lightBuffer);
+    }
+
+    void Renderer::createLightIndexBuffer(uint32_t currentFrame, uint32_t capacity)
+    {
+        LightFrameBuffers &lightBuffers = lightResources.frames[currentFrame];
+
+        destroyBuffer(lightBuffers.lightIndexBuffer, lightBuffers.lightIndexMemory);
+
+        createBuffer(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &lightBuffers.lightIndexBuffer, &lightBuffers.lightIndexMemory);
+        lightBuffers.lightIndexCapacity = capacity;
+
+        writeStorageBufferDescriptor(modelPipeline.descriptorSets[currentFrame], 5, lightBuffers.lightIndexBuffer);
+    }
+
+    void Renderer::updateLightClusters(uint32_t currentFrame, const glm::mat4 &projectionMat, const glm::mat4 &viewMat, glm::vec4 &clusterParams)
+    {
+        const std::vector<PointLight> &pointLights = lightResources.pointLights;
+        std::vector<LightCluster> &clusters = lightResources.clusters;
+        std::vector<uint32_t> &lightIndices = lightResources.lightIndices;
+        std::vector<std::array<uint32_t, 6>> &lightClusterBounds = lightResources.lightClusterBounds;
+
+        // Slices grow exponentially with depth, so a cluster is roughly as deep as it is wide on screen
+        const float nearPlane = projectionMat[3][2] / (projectionMat[2][2] - 1.0f);
+        const float farPlane = LIGHT_CLUSTER_DISTANCE;
+        const float sliceScale = LIGHT_CLUSTER_COUNT_Z / std::log(farPlane / nearPlane);
+        const float sliceBias = -std::log(nearPlane) * sliceScale;
+
+        clusterParams = glm::vec4(sliceScale, sliceBias, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height));
+
+        auto sliceAt = [&](float depth)
+        { return static_cast<uint32_t>(std::clamp(std::log(depth) * sliceScale + sliceBias, 0.0f, LIGHT_CLUSTER_COUNT_Z - 1.0f)); };
+
+        auto tileAt = [](float ndc, uint32_t tileCount)
+        { return static_cast<uint32_t>(std::clamp((ndc * 0.5f + 0.5f) * tileCount, 0.0f, tileCount - 1.0f)); };
+
+        // Conservative cluster range of every light, a light the camera can't see gets an empty one
+        lightClusterBounds.clear();
+        for (const PointLight &light : pointLights)
+        {
+            const glm::vec3 viewPos = glm::vec3(viewMat * glm::vec4(glm::vec3(light.positionRadius), 1.0f));
+            const float depth = -viewPos.z;
+            const float radius = light.positionRadius.w;
+
+            if (depth + radius < nearPlane || depth - radius > farPlane)
+            {
+                lightClusterBounds.push_back({1, 1, 1, 0, 0, 0});
+                continue;
+            }
+
+            std::array<uint32_t, 6> bounds = {0, 0, sliceAt(std::max(depth - radius, nearPlane)),
+                                              LIGHT_CLUSTER_COUNT_X - 1, LIGHT_CLUSTER_COUNT_Y - 1, sliceAt(std::min(depth + radius, farPlane))};
+
+            // A light around the near plane may cover any tile, otherwise its screen extent lies between the projections at its nearest and farthest depth
+            if (depth - radius > nearPlane)
+            {
+                glm::vec2 minNdc(std::numeric_limits<float>::max());
+                glm::vec2 maxNdc(std::numeric_limits<float>::lowest());
+
+                for (const float sampleDepth : {depth - radius, depth + radius})
+                {
+                    for (const float offset : {-radius, radius})
+                    {
+                        const glm::vec2 ndc((viewPos.x + offset) * projectionMat[0][0] / sampleDepth, (viewPos.y + offset) * projectionMat[1][1] / sampleDepth);
+                        minNdc = glm::min(minNdc, ndc);
+                        maxNdc = glm::max(maxNdc, ndc);
+                    }
+                }
+
+                bounds[0] = tileAt(minNdc.x, LIGHT_CLUSTER_COUNT_X);
+                bounds[1] = tileAt(minNdc.y, LIGHT_CLUSTER_COUNT_Y);
+                bounds[3] = tileAt(maxNdc.x, LIGHT_CLUSTER_COUNT_X);
+                bounds[4] = tileAt(maxNdc.y, LIGHT_CLUSTER_COUNT_Y);
+            }
+
+            lightClusterBounds.push_back(bounds);
+        }
+
+        // Counting sort of the light indices by cluster, the first pass counts and the second fills
+        auto forEachCluster = [](const std::array<uint32_t, 6> &bounds, auto &&callback)
+        {
+            for (uint32_t z = bounds[2]; z <= bounds[5]; z++)
+                for (uint32_t y = bounds[1]; y <= bounds[4]; y++)
+                    for (uint32_t x = bounds[0]; x <= bounds[3]; x++)
+                        callback(x + LIGHT_CLUSTER_COUNT_X * (y + LIGHT_CLUSTER_COUNT_Y * z));
+        };
+
+        clusters.assign(LIGHT_CLUSTER_COUNT, {0, 0});
+        for (const std::array<uint32_t, 6> &bounds : lightClusterBounds)
+            forEachCluster(bounds, [&](uint32_t clusterIndex)
+                           { clusters[clusterIndex].lightCount++; });
+
+        uint32_t lightIndexCount = 0;
+        for (LightCluster &cluster : clusters)
+        {
+            cluster.firstLight = lightIndexCount;
+            lightIndexCount += cluster.lightCount;
+            cluster.lightCount = 0;
+        }
+
+        lightIndices.resize(lightIndexCount);
+        for (uint32_t i = 0; i < lightClusterBounds.size(); i++)
+            forEachCluster(lightClusterBounds[i], [&](uint32_t clusterIndex)
+                           { lightIndices[clusters[clusterIndex].firstLight + clusters[clusterIndex].lightCount++] = i; });
+
+        LightFrameBuffers &lightBuffers = lightResources.frames[currentFrame];
+        const uint32_t lightCount = static_cast<uint32_t>(pointLights.size());
+
+        // This frame's fence has been waited on, so its buffers can be replaced
+        if (lightCount > lightBuffers.lightCapacity)
+            createLightBuffer(currentFrame, std::max(lightCount, lightBuffers.lightCapacity * 2));
+        if (lightIndexCount > lightBuffers.lightIndexCapacity)
+            createLightIndexBuffer(currentFrame, std::max(lightIndexCount, lightBuffers.lightIndexCapacity * 2));
+
+        memcpy(lightBuffers.lightMemory.mappedData, pointLights.data(), lightCount * sizeof(PointLight));
+        memcpy(lightBuffers.clusterMemory.mappedData, clusters.data(), LIGHT_CLUSTER_COUNT * sizeof(LightCluster));
+        memcpy(lightBuffers.lightIndexMemory.mappedData, lightIndices.data(), lightIndexCount * sizeof(uint32_t));
+    }
+}
@@ -4,116 +4,185 @@
 #include "Renderer.hpp"
 
 #include "../../shared/Log.hpp"
+#include "../../shared/MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
 
 namespace VE
 {
-    void Renderer::syncModelBuffers(const std::vector<Model> &models)
+    // Square root of the texture to model space area ratio over all triangles
+    static float computeUvDensity(const Mesh &mesh)
     {
-        std::vector<const Model *> modelsToInit;
+        const std::vector<Vertex> &vertices = mesh.getVertices();
+        const std::vector<uint32_t> &indices = mesh.getIndices();
 
-        for (const Model &model : models)
+        double modelArea = 0.0;
+        double uvArea = 0.0;
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
         {
-            bool modelBufferFound = false;
-            for (ModelBuffer &modelBuffer : modelBuffers)
-            {
-                if (model.getHandle() == modelBuffer.handle)
-                {
-                    modelBufferFound = true;
-                    if (model.getVersion() > modelBuffer.version)
-                    {
-                        updateModelBuffer(modelBuffer, model);
-                    }
-                    break;
-                }
-            }
+            const Vertex &a = vertices[indices[i]];
+            const Vertex &b = vertices[indices[i + 1]];
+            const Vertex &c = vertices[indices[i + 2]];
 
-            if (!modelBufferFound)
-                modelsToInit.push_back(&model);
-        }
+            modelArea += glm::length(glm::cross(b.pos - a.pos, c.pos - a.pos));
 
-        if (modelsToInit.size() == 1)
-        {
-            initModelBuffer(*modelsToInit.front());
+            const glm::vec2 uvEdge0 = b.tex - a.tex;
+            const glm::vec2 uvEdge1 = c.tex - a.tex;
+            uvArea += std::abs(uvEdge0.x * uvEdge1.y - uvEdge0.y * uvEdge1.x);
         }
-        else if (modelsToInit.size() > 1)
+
+        return modelArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / modelArea)) : 0.0f;
+    }
+
+    void Renderer::syncModelBuffers(const std::vector<Model> &models)
+    {
+        publishModelBuffers(models);
+
+        for (const Model &model : models)
         {
-            modelMutex.unlock();
+            uint64_t knownVersion = 0;
 
-            std::vector<std::thread> workers;
-            workers.reserve(modelsToInit.size());
-            for (const Model *modelPtr : modelsToInit)
+            auto queued = queuedModelVersions.find(model.getHandle().getValue());
+            if (queued != queuedModelVersions.end())
+                knownVersion = queued->second;
+            else if (const ModelBuffer *modelBuffer = findModelBuffer(model.getHandle()))
+                knownVersion = modelBuffer->version;
+
+            if (model.getVersion() > knownVersion)
             {
-                workers.emplace_back([this, modelPtr]
-                                     { initModelBuffer(*modelPtr); });
-            }
+                queuedModelVersions[model.getHandle().getValue()] = model.getVersion();
+
+                // Every model a level adds arrives in one sync, so its textures decode while earlier uploads run
+                prefetchTextures(model.getMeshes());
 
-            for (std::thread &w : workers)
-                w.join();
+                submitUploadJob([this, model](UploadContext &context)
+                                {
+                                    ModelBuffer newModelBuffer = createModelBuffer(context, model);
 
-            modelMutex.lock();
+                                    std::lock_guard<std::mutex> lock(completedUploads.mutex);
+                                    completedUploads.models.push_back(std::move(newModelBuffer)); });
+            }
         }
     }
 
-    void Renderer::createVertexBuffer(MeshBuffer &meshBuffer, const std::vector<Vertex> &vertices)
+    void Renderer::publishModelBuffers(const std::vector<Model> &models)
     {
-        VkDeviceSize bufferSize = sizeof(Vertex) * vertices.size();
+        std::vector<ModelBuffer> completed;
+        {
+            std::lock_guard<std::mutex> lock(completedUploads.mutex);
+            completed.swap(completedUploads.models);
+        }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
+        // Buffers reusing a texture whose upload isn't submitted yet wait for a later frame
+        auto pending = std::stable_partition(completed.begin(), completed.end(), [](const ModelBuffer &modelBuffer)
+                                             { return areTextureUploadsSubmitted(modelBuffer.sharedTextureUploads); });
+        if (pending != completed.end())
+        {
+            std::lock_guard<std::mutex> lock(completedUploads.mutex);
+            completedUploads.models.insert(completedUploads.models.end(), std::make_move_iterator(pending), std::make_move_iterator(completed.end()));
+            completed.erase(pending, completed.end());
+        }
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+        if (completed.empty())
+            return;
+
+        std::unordered_set<uint64_t> aliveModels;
+        aliveModels.reserve(models.size());
+        for (const Model &model : models)
+            aliveModels.insert(model.getHandle().getValue());
 
-        void *data;
-        vkCheck(vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data), {'V', 236});
-        memcpy(data, vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+        for (ModelBuffer &newModelBuffer : completed)
+        {
+            auto queued = queuedModelVersions.find(newModelBuffer.handle.getValue());
+            if (queued != queuedModelVersions.end() && queued->second == newModelBuffer.version)
+                queuedModelVersions.erase(queued);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshBuffer.vertexBuffer, &meshBuffer.vertexBufferMemory);
+            const bool isModelAlive = aliveModels.contains(newModelBuffer.handle.getValue());
 
-        CommandPoolGuard transferCommandPoolLocal(device, transferQueueFamilyIndex);
+            ModelBuffer *existing = findModelBuffer(newModelBuffer.handle);
 
-        VkFence uploadFence = VK_NULL_HANDLE;
-        VkFenceCreateInfo fenceCreateInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-        vkCheck(vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence), {'V', 216});
+            // The model was removed or a newer version got here first. Nothing draws these buffers, but their
+            // transfer may still be running and their acquires are recorded this frame, so they retire like drawn ones
+            if (!isModelAlive || (existing && existing->version >= newModelBuffer.version))
+            {
+                if (!isModelAlive)
+                    queuedModelVersions.erase(newModelBuffer.handle.getValue());
 
-        vkCheck(copyBuffer(transferCommandPoolLocal, stagingBuffer, meshBuffer.vertexBuffer, bufferSize, uploadFence), {'V', 224});
+                retireMeshBuffers(std::move(newModelBuffer.meshBuffers));
+                continue;
+            }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+            if (!existing)
+            {
+                addModelBuffer(std::move(newModelBuffer));
+                continue;
+            }
 
-        vkDestroyFence(device, uploadFence, nullptr);
+            // Frames still in flight keep drawing the old meshes, the new ones are used from this frame on
+            retireMeshBuffers(std::move(existing->meshBuffers));
+
+            *existing = std::move(newModelBuffer);
+
+            invalidateStaticShadows();
+        }
     }
 
-    void Renderer::createIndexBuffer(MeshBuffer &meshBuffer, const std::vector<uint32_t> &indices)
+    void Renderer::createMeshGeometry(UploadBatch &batch, MeshBuffer &meshBuffer, const Mesh &mesh, bool allowPacking)
     {
-        VkDeviceSize bufferSize = sizeof(uint32_t) * indices.size();
+        const std::vector<Vertex> &vertices = mesh.getVertices();
+        const std::vector<uint32_t> &indices = mesh.getIndices();
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+        meshBuffer.vertexCount = vertices.size();
+        meshBuffer.indexCount = indices.size();
+        meshBuffer.bounds = mesh.getBounds();
 
-        void *data;
-        vkCheck(vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data), {'V', 236});
-        memcpy(data, indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+        const void *vertexData = vertices.data();
+        VkDeviceSize vertexStride = sizeof(Vertex);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshBuffer.indexBuffer, &meshBuffer.indexBufferMemory);
+        PackedMesh packedMesh;
+        if (allowPacking && packVertices(vertices, packedMesh))
+        {
+            meshBuffer.isPacked = true;
+            meshBuffer.dequantizeMat = packedMesh.dequantizeMat;
 
-        CommandPoolGuard transferCommandPoolLocal(device, transferQueueFamilyIndex);
+            vertexData = packedMesh.vertices.data();
+            vertexStride = sizeof(PackedVertex);
+        }
 
-        VkFence uploadFence = VK_NULL_HANDLE;
-        VkFenceCreateInfo fenceCreateInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-        vkCheck(vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence), {'V', 216});
+        std::vector<uint16_t> shortIndices;
+        const void *indexData = indices.data();
+        VkDeviceSize indexStride = sizeof(uint32_t);
+
+        if (mesh.getIndexType() == MESH_INDEX_TYPE_UINT16)
+        {
+            shortIndices.assign(indices.begin(), indices.end());
+
+            meshBuffer.indexType = VK_INDEX_TYPE_UINT16;
+            indexData = shortIndices.data();
+            indexStride = sizeof(uint16_t);
+        }
 
-        vkCheck(copyBuffer(transferCommandPoolLocal, stagingBuffer, meshBuffer.indexBuffer, bufferSize, uploadFence), {'V', 224});
+        const VkDeviceSize vertexBytes = vertexStride * vertices.size();
+        const VkDeviceSize indexBytes = indexStride * indices.size();
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        allocateGeometry(meshBuffer, vertexStride, vertexBytes, indexStride, indexBytes);
 
-        vkDestroyFence(device, uploadFence, nullptr);
+        VkBuffer vertexBuffer;
+        VkBuffer indexBuffer;
+        {
+            std::lock_guard<std::mutex> lock(geometryMutex);
+            vertexBuffer = geometryPages[meshBuffer.geometryPageIndex].vertexBuffer;
+            indexBuffer = geometryPages[meshBuffer.geometryPageIndex].indexBuffer;
+        }
+
+        uploadBuffer(batch, vertexBuffer, meshBuffer.vertexRange.offset, vertexData, vertexBytes);
+        uploadBuffer(batch, indexBuffer, meshBuffer.indexRange.offset, indexData, indexBytes);
     }
 
-    void Renderer::initModelBuffer(const Model &model)
+    Renderer::ModelBuffer Renderer::createModelBuffer(UploadContext &context, const Model &model)
     {
         ModelBuffer newModelBuffer(model.getHandle());
 
@@ -121,91 +190,98 @@ namespace VE
 
         newModelBuffer.materials = model.getMaterials();
 
+        UploadBatch uploadBatch;
+        beginUploadBatch(context, uploadBatch);
+
         for (const Mesh &mesh : model.getMeshes())
         {
             MeshBuffer newMeshBuffer;
 
-            const std::vector<Vertex> &vertices = mesh.getVertices();
-            const std::vector<uint32_t> &indices = mesh.getIndices();
-
             newMeshBuffer.materialIndex = mesh.getMaterialIndex();
 
             if(newModelBuffer.materials[newMeshBuffer.materialIndex].baseColor.a < 1.0f)
                 newMeshBuffer.isTransparent = true;
 
-            newMeshBuffer.vertexCount = vertices.size();
-            newMeshBuffer.indexCount = indices.size();
-            createVertexBuffer(newMeshBuffer, vertices);
-            createIndexBuffer(newMeshBuffer, indices);
+            createMeshGeometry(uploadBatch, newMeshBuffer, mesh, true);
 
             if (!mesh.getTextureFilePath().empty())
-                newMeshBuffer.texIndex = createTexture(mesh.getTextureFilePath());
+            {
+                newMeshBuffer.texIndex = createTexture(uploadBatch, mesh.getTextureFilePath(), true);
+                newMeshBuffer.uvDensity = computeUvDensity(mesh);
+            }
 
             newModelBuffer.meshBuffers.push_back(newMeshBuffer);
         }
 
-        {
-            std::lock_guard<std::recursive_mutex> lock(modelMutex);
-            modelBuffers.push_back(newModelBuffer);
-        }
+        endUploadBatch(uploadBatch);
+
+        newModelBuffer.sharedTextureUploads = std::move(uploadBatch.sharedTextureUploads);
+
+        return newModelBuffer;
     }
 
-    void Renderer::updateModelBuffer(ModelBuffer &modelBuffer, const Model &model)
+    Renderer::ModelBuffer *Renderer::findModelBuffer(ModelHandle handle)
     {
-        {
-            std::lock_guard<std::mutex> lock(graphicsQueueMutex);
-            vkCheck(vkDeviceWaitIdle(device), {'V', 235});
-        }
+        auto it = modelBufferIndices.find(handle.getValue());
+        return it == modelBufferIndices.end() ? nullptr : &modelBuffers[it->second];
+    }
 
-        for (MeshBuffer &meshBuffer : modelBuffer.meshBuffers)
-            destroyMeshBuffer(meshBuffer);
+    void Renderer::addModelBuffer(ModelBuffer &&modelBuffer)
+    {
+        modelBufferIndices[modelBuffer.handle.getValue()] = static_cast<uint32_t>(modelBuffers.size());
+        modelBuffers.push_back(std::move(modelBuffer));
 
-        modelBuffer.meshBuffers.clear();
+        invalidateStaticShadows();
+    }
 
-        modelBuffer.materials = model.getMaterials();
+    void Renderer::eraseModelBuffer(uint32_t index)
+    {
+        modelBufferIndices.erase(modelBuffers[index].handle.getValue());
+        retireMeshBuffers(std::move(modelBuffers[index].meshBuffers));
 
-        for (const Mesh &mesh : model.getMeshes())
+        // Swap the last buffer into the hole so the rest keep their indices
+        if (index != modelBuffers.size() - 1)
         {
-            MeshBuffer newMeshBuffer;
-            newMeshBuffer.materialIndex = mesh.getMaterialIndex();
-            if(modelBuffer.materials[newMeshBuffer.materialIndex].baseColor.a < 1.0f)
-                newMeshBuffer.isTransparent = true;
-            newMeshBuffer.vertexCount = mesh.getVertices().size();
-            newMeshBuffer.indexCount = mesh.getIndices().size();
-            createVertexBuffer(newMeshBuffer, mesh.getVertices());
-            createIndexBuffer(newMeshBuffer, mesh.getIndices());
-            modelBuffer.meshBuffers.push_back(newMeshBuffer);
+            modelBuffers[index] = std::move(modelBuffers.back());
+            modelBufferIndices[modelBuffers[index].handle.getValue()] = index;
         }
+        modelBuffers.pop_back();
 
-        modelBuffer.version = model.getVersion();
+        invalidateStaticShadows();
     }
 
     void Renderer::removeOrphanedModel(const std::vector<ModelInstance> &modelInstances)
     {
-        vkDeviceWaitIdle(device);
-        for (std::vector<ModelBuffer>::iterator it = modelBuffers.begin(); it != modelBuffers.end();)
-        {
-            bool hasInstance = false;
-            for (const ModelInstance &instance : modelInstances)
-            {
-                if (instance.modelHandle == it->handle)
-                {
-                    hasInstance = true;
-                    break;
-                }
-            }
+        for (ModelBuffer &modelBuffer : modelBuffers)
+            modelBuffer.instanceCount = 0;
 
-            if (!hasInstance)
-            {
-                for (MeshBuffer &meshBuffer : it->meshBuffers)
-                    destroyMeshBuffer(meshBuffer);
+        for (const ModelInstance &instance : modelInstances)
+            if (ModelBuffer *modelBuffer = findModelBuffer(instance.modelHandle))
+                modelBuffer->instanceCount++;
 
-                it = modelBuffers.erase(it);
-            }
+        for (uint32_t i = 0; i < modelBuffers.size();)
+        {
+            if (modelBuffers[i].instanceCount == 0)
+                eraseModelBuffer(i);
             else
-            {
-                ++it;
-            }
+                i++;
+        }
+    }
+
+    void Renderer::retireMeshBuffers(std::vector<MeshBuffer> &&meshBuffers)
+    {
+        retiredMeshBuffers.push_back({std::move(meshBuffers), frameIndex});
+    }
+
+    void Renderer::destroyRetiredMeshBuffers()
+    {
+        // Called after waiting on this frame's fence, which covers everything FRAMES_IN_FLIGHT frames back
+        while (!retiredMeshBuffers.empty() && retiredMeshBuffers.front().frameIndex + FRAMES_IN_FLIGHT <= frameIndex)
+        {
+            for (MeshBuffer &meshBuffer : retiredMeshBuffers.front().meshBuffers)
+                destroyMeshBuffer(meshBuffer);
+
+            retiredMeshBuffers.pop_front();
         }
     }
-}
\ No newline at end of file
+}
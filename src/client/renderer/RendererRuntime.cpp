@@ -8,33 +8,439 @@
 #include <GLFW/glfw3.h>
 #include <array>
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <tuple>
 
 namespace VE
 {
-    void Renderer::recordShadowPass(const std::vector<Model> &models, const std::vector<ModelInstance> &modelInstances, const glm::mat4 &lightSpaceMat)
+    void Renderer::updateInstanceBuffer(uint32_t currentFrame, const std::vector<ModelInstance> &modelInstances)
+    {
+        std::vector<InstanceData> &instanceData = instanceResources.data;
+        std::vector<InstanceBatch> &instanceBatches = instanceResources.batches;
+
+        // Counting sort by model buffer, then static before dynamic, so each batch is contiguous and draws as one
+        std::vector<uint32_t> instanceBatchKeys(modelInstances.size(), UINT32_MAX);
+        std::vector<uint32_t> instanceOffsets(modelBuffers.size() * 2 + 1, 0);
+
+        for (size_t i = 0; i < modelInstances.size(); i++)
+        {
+            auto it = modelBufferIndices.find(modelInstances[i].modelHandle.getValue());
+            if (it == modelBufferIndices.end())
+                continue;
+
+            instanceBatchKeys[i] = it->second * 2 + (modelInstances[i].isDynamic ? 1 : 0);
+            instanceOffsets[instanceBatchKeys[i] + 1]++;
+        }
+
+        instanceBatches.clear();
+        for (uint32_t batchKey = 0; batchKey < modelBuffers.size() * 2; batchKey++)
+        {
+            const uint32_t instanceCount = instanceOffsets[batchKey + 1];
+            instanceOffsets[batchKey + 1] += instanceOffsets[batchKey];
+
+            if (instanceCount > 0)
+                instanceBatches.push_back({batchKey / 2, instanceOffsets[batchKey], instanceCount, (batchKey & 1) != 0});
+        }
+
+        const uint32_t instanceCount = instanceOffsets.back();
+        instanceData.resize(instanceCount);
+
+        for (size_t i = 0; i < modelInstances.size(); i++)
+        {
+            if (instanceBatchKeys[i] == UINT32_MAX)
+                continue;
+
+            InstanceData &data = instanceData[instanceOffsets[instanceBatchKeys[i]]++];
+            data.model = modelInstances[i].modelMat;
+            data.lightColor = glm::vec3(modelInstances[i].lightColor);
+            data.lightStrength = modelInstances[i].lightStrength;
+        }
+
+        // This frame's fence has been waited on, so its buffer can be replaced
+        if (instanceCount > instanceResources.capacities[currentFrame])
+            createInstanceBuffer(currentFrame, std::max(instanceCount, instanceResources.capacities[currentFrame] * 2));
+
+        memcpy(instanceResources.memories[currentFrame].mappedData, instanceData.data(), instanceCount * sizeof(InstanceData));
+    }
+
+    void Renderer::updateDrawBuffers(uint32_t currentFrame, const glm::vec3 &cameraPosition, const Frustum &frustum, bool hasSun)
+    {
+        drawResources.data.clear();
+        drawResources.commands.clear();
+        for (std::vector<DrawRun> &cascadeRuns : drawResources.shadowRuns)
+            cascadeRuns.clear();
+        for (std::vector<DrawRun> &cascadeRuns : drawResources.staticShadowRuns)
+            cascadeRuns.clear();
+        drawResources.opaqueRuns.clear();
+        drawResources.transparentRuns.clear();
+        drawResources.cullRunCount = 0;
+        drawResources.visibleInstanceCount = 0;
+
+        struct PendingDraw
+        {
+            const MeshBuffer *meshBuffer;
+            const Material *material;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+            float distanceSquared;
+        };
+        std::vector<PendingDraw> dynamicShadowDraws;
+        std::vector<PendingDraw> staticShadowDraws;
+        std::vector<PendingDraw> opaqueDraws;
+        std::vector<PendingDraw> transparentDraws;
+
+        std::vector<float> &instanceScales = drawResources.instanceScales;
+        SphereList &spheres = drawResources.cullingSpheres;
+        std::vector<uint8_t> &visible = drawResources.cullingResults;
+
+        for (const InstanceBatch &batch : instanceResources.batches)
+        {
+            const ModelBuffer &modelBuffer = modelBuffers[batch.modelBufferIndex];
+
+            instanceScales.clear();
+
+            for (const MeshBuffer &meshBuffer : modelBuffer.meshBuffers)
+            {
+                const Material *material = &modelBuffer.materials[meshBuffer.materialIndex];
+
+                // One draw over all instances, the culling pass drops the ones outside each cascade or the camera frustum
+                if (hasSun)
+                    (batch.isDynamic ? dynamicShadowDraws : staticShadowDraws).push_back({&meshBuffer, nullptr, batch.firstInstance, batch.instanceCount, 0.0f});
+
+                if (!meshBuffer.isTransparent)
+                {
+                    opaqueDraws.push_back({&meshBuffer, material, batch.firstInstance, batch.instanceCount, 0.0f});
+                    continue;
+                }
+
+                // Transparent meshes are sorted back to front on the CPU, so they are also culled here
+                if (instanceScales.empty())
+                {
+                    // Largest axis scale of each instance, the mesh spheres grow by it in world space
+                    for (uint32_t i = 0; i < batch.instanceCount; i++)
+                    {
+                        const glm::mat4 &modelMat = instanceResources.data[batch.firstInstance + i].model;
+                        const float scaleSquared = std::max({glm::dot(glm::vec3(modelMat[0]), glm::vec3(modelMat[0])),
+                                                             glm::dot(glm::vec3(modelMat[1]), glm::vec3(modelMat[1])),
+                                                             glm::dot(glm::vec3(modelMat[2]), glm::vec3(modelMat[2]))});
+                        instanceScales.push_back(std::sqrt(scaleSquared));
+                    }
+                }
+
+                spheres.clear();
+                for (uint32_t i = 0; i < batch.instanceCount; i++)
+                {
+                    const glm::vec3 center = glm::vec3(instanceResources.data[batch.firstInstance + i].model * glm::vec4(meshBuffer.bounds.center, 1.0f));
+                    spheres.add(center, meshBuffer.bounds.radius * instanceScales[i]);
+                }
+
+                cullSpheres(frustum, spheres, visible);
+
+                for (uint32_t i = 0; i < batch.instanceCount; i++)
+                {
+                    if (!visible[i])
+                        continue;
+
+                    const uint32_t instanceIndex = batch.firstInstance + i;
+                    glm::vec3 meshWorldPosition = glm::vec3(instanceResources.data[instanceIndex].model[3]);
+                    float distanceSquared = glm::dot(meshWorldPosition - cameraPosition, meshWorldPosition - cameraPosition);
+                    transparentDraws.push_back({&meshBuffer, material, instanceIndex, 1, distanceSquared});
+                }
+            }
+        }
+
+        // Opaque and shadow draws can go in any order, sorting by state keeps the runs few and long
+        auto byState = [](const PendingDraw &leftDraw, const PendingDraw &rightDraw)
+        {
+            const MeshBuffer &left = *leftDraw.meshBuffer;
+            const MeshBuffer &right = *rightDraw.meshBuffer;
+            return std::tie(left.isPacked, left.geometryPageIndex, left.indexType) < std::tie(right.isPacked, right.geometryPageIndex, right.indexType);
+        };
+        std::sort(dynamicShadowDraws.begin(), dynamicShadowDraws.end(), byState);
+        std::sort(staticShadowDraws.begin(), staticShadowDraws.end(), byState);
+        std::sort(opaqueDraws.begin(), opaqueDraws.end(), byState);
+
+        std::sort(transparentDraws.begin(), transparentDraws.end(),
+                  [](const PendingDraw &leftDraw, const PendingDraw &rightDraw)
+                  { return leftDraw.distanceSquared > rightDraw.distanceSquared; });
+
+        // Each cascade's draws are contiguous so one dispatch culls them against its frustum, without a sun every range is empty
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+        {
+            drawResources.shadowDrawRanges[i].firstDraw = static_cast<uint32_t>(drawResources.commands.size());
+
+            for (const PendingDraw &draw : dynamicShadowDraws)
+                appendDrawRun(*draw.meshBuffer, draw.material, shadowPipeline, draw.firstInstance, draw.instanceCount, true, drawResources.shadowRuns[i]);
+
+            if (!shadowCache.isLayerValid[i])
+                for (const PendingDraw &draw : staticShadowDraws)
+                    appendDrawRun(*draw.meshBuffer, draw.material, shadowPipeline, draw.firstInstance, draw.instanceCount, true, drawResources.staticShadowRuns[i]);
+
+            drawResources.shadowDrawRanges[i].drawCount = static_cast<uint32_t>(drawResources.commands.size()) - drawResources.shadowDrawRanges[i].firstDraw;
+        }
+
+        drawResources.opaqueDrawRange.firstDraw = static_cast<uint32_t>(drawResources.commands.size());
+        for (const PendingDraw &draw : opaqueDraws)
+            appendDrawRun(*draw.meshBuffer, draw.material, modelPipeline, draw.firstInstance, draw.instanceCount, true, drawResources.opaqueRuns);
+        drawResources.opaqueDrawRange.drawCount = static_cast<uint32_t>(opaqueDraws.size());
+
+        for (const PendingDraw &draw : transparentDraws)
+            appendDrawRun(*draw.meshBuffer, draw.material, transparentPipeline, draw.firstInstance, draw.instanceCount, false, drawResources.transparentRuns);
+
+        const uint32_t drawCount = static_cast<uint32_t>(drawResources.commands.size());
+        DrawFrameBuffers &drawBuffers = drawResources.frames[currentFrame];
+
+        // This frame's fence has been waited on, so its buffers can be replaced
+        if (drawCount > drawBuffers.capacity)
+            createDrawBuffers(currentFrame, std::max(drawCount, drawBuffers.capacity * 2));
+        if (drawResources.visibleInstanceCount > drawBuffers.visibleInstanceCapacity)
+            createVisibleInstanceBuffer(currentFrame, std::max(drawResources.visibleInstanceCount, drawBuffers.visibleInstanceCapacity * 2));
+
+        memcpy(drawBuffers.dataMemory.mappedData, drawResources.data.data(), drawCount * sizeof(DrawData));
+        memcpy(drawBuffers.commandMemory.mappedData, drawResources.commands.data(), drawCount * sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    void Renderer::appendDrawRun(const MeshBuffer &meshBuffer, const Material *material, const GraphicsPipeline &pipeline, uint32_t firstInstance, uint32_t instanceCount, bool isCulled, std::vector<DrawRun> &runs)
+    {
+        const VkPipeline meshPipeline = meshBuffer.isPacked ? pipeline.packedPipeline : pipeline.pipeline;
+
+        // Depth-only draws have no material and sample no texture, a missing one falls back to the base colour
+        const bool hasTexture = material && !textures.streams[meshBuffer.texIndex].isMissing;
+        const uint32_t texIndex = hasTexture ? meshBuffer.texIndex : INVALID_TEXTURE_INDEX;
+
+        const uint32_t drawIndex = static_cast<uint32_t>(drawResources.commands.size());
+
+        if (runs.empty() || runs.back().pipeline != meshPipeline || runs.back().geometryPageIndex != meshBuffer.geometryPageIndex ||
+            runs.back().indexType != meshBuffer.indexType)
+            runs.push_back({meshPipeline, meshBuffer.geometryPageIndex, meshBuffer.indexType, drawIndex, 0, isCulled ? drawResources.cullRunCount++ : UINT32_MAX});
+
+        DrawRun &run = runs.back();
+        run.drawCount++;
+
+        drawResources.commands.push_back({meshBuffer.indexCount, instanceCount, meshBuffer.firstIndex, meshBuffer.vertexOffset, firstInstance});
+
+        DrawData drawData{};
+        drawData.dequantizeMat = meshBuffer.dequantizeMat;
+        drawData.textureIndex = textureDescriptorIndex(texIndex);
+        if (material)
+        {
+            drawData.baseColor = material->baseColor;
+            drawData.metallic = material->metallic;
+            drawData.roughness = material->roughness;
+        }
+
+        if (isCulled)
+        {
+            drawData.countIndex = run.countIndex;
+            drawData.runFirstDraw = run.firstDraw;
+            drawData.visibleOffset = drawResources.visibleInstanceCount;
+            drawData.boundingSphere = glm::vec4(meshBuffer.bounds.center, meshBuffer.bounds.radius);
+
+            drawResources.visibleInstanceCount += instanceCount;
+        }
+
+        drawResources.data.push_back(drawData);
+    }
+
+    void Renderer::recordCullingPass(const Frustum &cameraFrustum, const ShadowCascades &shadowCascades)
+    {
+        const VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
+        const DrawFrameBuffers &drawBuffers = drawResources.frames[currentFrame];
+
+        if (drawResources.cullRunCount == 0)
+            return;
+
+        vkCmdFillBuffer(commandBuffer, drawBuffers.countBuffer, 0, drawResources.cullRunCount * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier memoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline.pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline.layout, 0, 1, &instanceResources.descriptorSets[currentFrame], 0, nullptr);
+
+        // One workgroup per draw, its threads walk the draw's instances
+        auto dispatchCulling = [&](const Frustum &frustum, const DrawRange &range)
+        {
+            if (range.drawCount == 0)
+                return;
+
+            CullPushData pushData;
+            pushData.frustumPlanes = frustum.planes;
+            pushData.firstDraw = range.firstDraw;
+            pushData.drawCount = range.drawCount;
+
+            vkCmdPushConstants(commandBuffer, cullPipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushData), &pushData);
+            vkCmdDispatch(commandBuffer, range.drawCount, 1, 1);
+        };
+
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+            dispatchCulling(extractFrustum(shadowCascades.lightSpaceMats[i]), drawResources.shadowDrawRanges[i]);
+        dispatchCulling(cameraFrustum, drawResources.opaqueDrawRange);
+
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void Renderer::recordDrawRuns(VkCommandBuffer commandBuffer, const std::vector<DrawRun> &runs, VkPipelineLayout layout, uint32_t firstDrawPushOffset)
+    {
+        const DrawFrameBuffers &drawBuffers = drawResources.frames[currentFrame];
+
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        GeometryBinding geometryBinding;
+
+        for (const DrawRun &run : runs)
+        {
+            if (run.pipeline != boundPipeline)
+            {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, run.pipeline);
+                boundPipeline = run.pipeline;
+            }
+
+            bindGeometry(commandBuffer, run.geometryPageIndex, run.indexType, geometryBinding);
+
+            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, firstDrawPushOffset, sizeof(uint32_t), &run.firstDraw);
+
+            const VkDeviceSize commandOffset = run.firstDraw * sizeof(VkDrawIndexedIndirectCommand);
+
+            // Culled runs draw however many commands the culling pass kept, packed at the start of the run
+            if (run.countIndex != UINT32_MAX)
+                vkCmdDrawIndexedIndirectCount(commandBuffer, drawBuffers.culledCommandBuffer, commandOffset, drawBuffers.countBuffer, run.countIndex * sizeof(uint32_t), run.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+            else
+                vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers.commandBuffer, commandOffset, run.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
+    std::array<glm::vec4, Renderer::SHADOW_CASCADE_COUNT> Renderer::fitShadowCascades(const glm::mat4 &projectionMat, const glm::mat4 &viewMat, glm::vec4 &splitDepths)
+    {
+        // Near and far planes back out of a -1..1 depth perspective matrix
+        const float nearPlane = projectionMat[3][2] / (projectionMat[2][2] - 1.0f);
+        const float farPlane = std::min(projectionMat[3][2] / (projectionMat[2][2] + 1.0f), SHADOW_DISTANCE);
+
+        const float tanHalfFovX = 1.0f / projectionMat[0][0];
+        const float tanHalfFovY = 1.0f / std::abs(projectionMat[1][1]);
+
+        const glm::mat4 inverseViewMat = glm::inverse(viewMat);
+
+        std::array<glm::vec4, SHADOW_CASCADE_COUNT> cascadeSpheres;
+
+        float splitNear = nearPlane;
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+        {
+            // Practical split scheme, logarithmic up close where perspective aliasing is worst
+            const float fraction = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+            const float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+            const float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+            const float splitFar = SHADOW_SPLIT_LAMBDA * logSplit + (1.0f - SHADOW_SPLIT_LAMBDA) * uniformSplit;
+
+            std::array<glm::vec3, 8> corners;
+            for (uint32_t j = 0; j < 8; j++)
+            {
+                const float depth = (j & 4) ? splitFar : splitNear;
+                const float x = ((j & 1) ? 1.0f : -1.0f) * tanHalfFovX * depth;
+                const float y = ((j & 2) ? 1.0f : -1.0f) * tanHalfFovY * depth;
+                corners[j] = glm::vec3(inverseViewMat * glm::vec4(x, y, -depth, 1.0f));
+            }
+
+            glm::vec3 center(0.0f);
+            for (const glm::vec3 &corner : corners)
+                center += corner;
+            center /= 8.0f;
+
+            // A sphere keeps the cascade the same size however the camera turns, so its texels don't shimmer
+            float radius = 0.0f;
+            for (const glm::vec3 &corner : corners)
+                radius = std::max(radius, glm::length(corner - center));
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            cascadeSpheres[i] = glm::vec4(center, radius);
+            splitDepths[i] = splitFar;
+
+            splitNear = splitFar;
+        }
+
+        return cascadeSpheres;
+    }
+
+    glm::mat4 Renderer::computeCascadeMat(const glm::vec4 &cascadeSphere, const glm::vec3 &lightDirection)
+    {
+        const glm::vec3 center(cascadeSphere);
+        const float radius = cascadeSphere.w;
+
+        const glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+
+        const glm::mat4 lightView = glm::lookAt(center + lightDirection * (radius + SHADOW_CASTER_DISTANCE), center, up);
+        glm::mat4 lightProjection = glm::orthoZO(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + SHADOW_CASTER_DISTANCE);
+
+        // Snap the projection to whole texels so refits don't make the shadow edges crawl
+        const glm::vec2 halfExtent(SHADOW_MAP_EXTENT.w * 0.5f, SHADOW_MAP_EXTENT.h * 0.5f);
+        const glm::vec4 projectedOrigin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        const glm::vec2 origin = glm::vec2(projectedOrigin.x, projectedOrigin.y) * halfExtent;
+        const glm::vec2 offset = (glm::round(origin) - origin) / halfExtent;
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+
+        return lightProjection * lightView;
+    }
+
+    const Renderer::ShadowCascades &Renderer::updateShadowCascades(const glm::mat4 &projectionMat, const glm::mat4 &viewMat, const glm::vec3 &lightDirection, uint64_t staticInstanceVersion)
+    {
+        const std::array<glm::vec4, SHADOW_CASCADE_COUNT> cascadeSpheres = fitShadowCascades(projectionMat, viewMat, shadowCache.cascades.splitDepths);
+
+        if (staticInstanceVersion != shadowCache.staticInstanceVersion)
+        {
+            shadowCache.staticInstanceVersion = staticInstanceVersion;
+            invalidateStaticShadows();
+        }
+
+        const bool hasLightTurned = glm::dot(lightDirection, shadowCache.lightDirection) < SHADOW_CACHE_MIN_LIGHT_DOT;
+        if (hasLightTurned)
+            shadowCache.lightDirection = lightDirection;
+
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+        {
+            const glm::vec4 &fitted = cascadeSpheres[i];
+            const glm::vec4 &cached = shadowCache.cascadeSpheres[i];
+
+            // The cached cascade stays while it still contains the camera's slice
+            const bool isContained = glm::length(glm::vec3(fitted) - glm::vec3(cached)) + fitted.w <= cached.w;
+            if (isContained && !hasLightTurned)
+                continue;
+
+            shadowCache.cascadeSpheres[i] = glm::vec4(glm::vec3(fitted), std::ceil(fitted.w * (1.0f + SHADOW_CACHE_MARGIN) * 16.0f) / 16.0f);
+            shadowCache.cascades.lightSpaceMats[i] = computeCascadeMat(shadowCache.cascadeSpheres[i], shadowCache.lightDirection);
+            shadowCache.isLayerValid[i] = false;
+        }
+
+        return shadowCache.cascades;
+    }
+
+    void Renderer::invalidateStaticShadows()
+    {
+        // Model buffers don't know whether static or dynamic instances use them, so any change redraws the cache
+        shadowCache.isLayerValid.fill(false);
+    }
+
+    void Renderer::recordShadowPass(const std::vector<Model> &models, const ShadowCascades &shadowCascades)
     {
         const VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
 
         VkImageMemoryBarrier imageMemoryBarrier{};
         imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.image = shadowDepthAttachment.image;
         imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
         imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
         imageMemoryBarrier.subresourceRange.levelCount = 1;
-        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarrier.subresourceRange.layerCount = 1;
-        imageMemoryBarrier.srcAccessMask = 0;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 
         VkRenderingAttachmentInfo shadowDepthAttachmentInfo{};
         shadowDepthAttachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-        shadowDepthAttachmentInfo.imageView = shadowDepthAttachment.imageView;
         shadowDepthAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         shadowDepthAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         shadowDepthAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -47,71 +453,134 @@ namespace VE
         shadowRenderingInfo.layerCount = 1;
         shadowRenderingInfo.pDepthAttachment = &shadowDepthAttachmentInfo;
 
-        vkCmdBeginRendering(commandBuffer, &shadowRenderingInfo);
+        auto recordCascade = [&](VkImageView cascadeView, uint32_t cascadeIndex, const std::vector<DrawRun> &runs)
+        {
+            shadowDepthAttachmentInfo.imageView = cascadeView;
+
+            vkCmdBeginRendering(commandBuffer, &shadowRenderingInfo);
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline.pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline.layout, 0, 1, &instanceResources.descriptorSets[currentFrame], 0, nullptr);
+
+            vkCmdPushConstants(commandBuffer, shadowPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(ShadowPushData, lightSpaceMat), sizeof(glm::mat4), &shadowCascades.lightSpaceMats[cascadeIndex]);
+
+            recordDrawRuns(commandBuffer, runs, shadowPipeline.layout, offsetof(ShadowPushData, firstDraw));
+
+            vkCmdEndRendering(commandBuffer);
+        };
 
-        for (const ModelInstance &instance : modelInstances)
+        // Redraw the static casters of the cache layers that went stale, the cache rests in TRANSFER_SRC between frames
+        imageMemoryBarrier.image = shadowCache.staticAttachment.image;
+        imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
         {
-            for (const ModelBuffer &modelBuffer : modelBuffers)
-            {
-                if (instance.modelHandle == modelBuffer.handle)
-                {
-                    for (const MeshBuffer &meshBuffer : modelBuffer.meshBuffers)
-                    {
-                        VkBuffer vertexBuffers[] = {meshBuffer.vertexBuffer};
-                        VkDeviceSize offsets[] = {0};
-                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-                        vkCmdBindIndexBuffer(commandBuffer, meshBuffer.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            if (shadowCache.isLayerValid[i])
+                continue;
 
-                        ShadowPushData pushData{};
-                        pushData.model = instance.modelMat;
-                        pushData.lightSpaceMat = lightSpaceMat;
+            imageMemoryBarrier.subresourceRange.baseArrayLayer = i;
+            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            imageMemoryBarrier.srcAccessMask = 0;
+            imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-                        vkCmdPushConstants(commandBuffer, shadowPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushData), &pushData);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 
-                        vkCmdDrawIndexed(commandBuffer, meshBuffer.indexCount, 1, 0, 0, 0);
-                    }
-                    break;
-                }
-            }
+            recordCascade(shadowCache.staticCascadeViews[i], i, drawResources.staticShadowRuns[i]);
+
+            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            imageMemoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+            shadowCache.isLayerValid[i] = true;
         }
 
-        vkCmdEndRendering(commandBuffer);
+        // Every cascade starts from its cached static depth
+        imageMemoryBarrier.image = shadowDepthAttachment.image;
+        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+        imageMemoryBarrier.subresourceRange.layerCount = SHADOW_CASCADE_COUNT;
+        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageMemoryBarrier.srcAccessMask = 0;
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+        VkImageCopy imageCopy{};
+        imageCopy.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, SHADOW_CASCADE_COUNT};
+        imageCopy.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, SHADOW_CASCADE_COUNT};
+        imageCopy.extent = {SHADOW_MAP_EXTENT.w, SHADOW_MAP_EXTENT.h, 1};
+
+        vkCmdCopyImage(commandBuffer, shadowCache.staticAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, shadowDepthAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy);
+
+        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+        // Dynamic casters go on top of the copy
+        shadowDepthAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
+            recordCascade(shadowCascadeViews[i], i, drawResources.shadowRuns[i]);
 
         imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         imageMemoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
         imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+        isShadowMapReadable = true;
+    }
+
+    void Renderer::recordUnlitShadowMap()
+    {
+        // The main pass still binds the shadow map, its contents don't matter as nothing samples it
+        if (isShadowMapReadable)
+            return;
+
+        VkImageMemoryBarrier imageMemoryBarrier{};
+        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarrier.image = shadowDepthAttachment.image;
+        imageMemoryBarrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, SHADOW_CASCADE_COUNT};
+        imageMemoryBarrier.srcAccessMask = 0;
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(frames[currentFrame].commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+        isShadowMapReadable = true;
     }
 
-    void Renderer::updateModelUniformBuffers(uint32_t currentFrame, glm::mat4 projectionMat, glm::mat4 viewMat, glm::vec4 lightPos, glm::vec3 lightColor, glm::mat4 lightSpaceMat, float outdoorBrightness)
+    void Renderer::updateModelUniformBuffers(uint32_t currentFrame, glm::mat4 projectionMat, glm::mat4 viewMat, glm::vec4 sunDirection, glm::vec3 sunColor, const ShadowCascades &shadowCascades, const glm::vec4 &clusterParams, float outdoorBrightness)
     {
         UboCamera uboCamera;
         uboCamera.projection = projectionMat;
         uboCamera.view = viewMat;
-        uboCamera.lightSpaceMat = lightSpaceMat;
 
-        void *cameraData;
-        vkCheck(vkMapMemory(device, cameraUniformBufferMemory[currentFrame], 0, sizeof(UboCamera), 0, &cameraData), {'V', 236});
-        memcpy(cameraData, &uboCamera, sizeof(UboCamera));
-        vkUnmapMemory(device, cameraUniformBufferMemory[currentFrame]);
+        memcpy(cameraUniformBufferMemory[currentFrame].mappedData, &uboCamera, sizeof(UboCamera));
 
         UboLighting uboLighting;
-        uboLighting.lightPos = lightPos;
-        uboLighting.lightColor = glm::vec4(lightColor, 1.0f);
+        uboLighting.sunDirection = sunDirection;
+        uboLighting.sunColor = glm::vec4(sunColor, 1.0f);
         uboLighting.viewPos = glm::inverse(viewMat)[3];
+        uboLighting.shadowCascades = shadowCascades;
+        uboLighting.clusterParams = clusterParams;
         uboLighting.outdoorBrightness = outdoorBrightness;
+        uboLighting.pointLightCount = static_cast<uint32_t>(lightResources.pointLights.size());
 
-        void *lightingData;
-        vkCheck(vkMapMemory(device, lightingUniformBufferMemory[currentFrame], 0, sizeof(UboLighting), 0, &lightingData), {'V', 236});
-        memcpy(lightingData, &uboLighting, sizeof(UboLighting));
-        vkUnmapMemory(device, lightingUniformBufferMemory[currentFrame]);
+        memcpy(lightingUniformBufferMemory[currentFrame].mappedData, &uboLighting, sizeof(UboLighting));
     }
 
-    void Renderer::recordMainPass(uint32_t currentImage, const std::vector<Model> &models, const std::vector<ModelInstance> &modelInstances, color_t backgroundColor, const glm::mat4 &lightSpaceMat, const glm::vec3 &cameraPosition)
+    void Renderer::recordMainPass(uint32_t currentImage, const std::vector<Model> &models, color_t backgroundColor)
     {
         const VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
 
@@ -159,8 +628,6 @@ namespace VE
 
         vkCmdBeginRendering(commandBuffer, &renderingInfo);
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.pipeline);
-
         VkViewport viewport = {
             .x = 0.0f,
             .y = 0.0f,
@@ -175,79 +642,12 @@ namespace VE
             .extent = swapChainExtent};
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        auto drawMesh = [&](const ModelInstance &instance, const MeshBuffer &meshBuffer, Material material, VkPipelineLayout layout)
-        {
-            VkBuffer vertexBuffers[] = {meshBuffer.vertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        // Bound once for the whole pass, the transparent layout is compatible
+        std::array<VkDescriptorSet, 3> descriptorSets = {modelPipeline.descriptorSets[currentFrame], textures.descriptorSet, instanceResources.descriptorSets[currentFrame]};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.layout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
 
-            vkCmdBindIndexBuffer(commandBuffer, meshBuffer.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-            VertexPushData vertexPushData;
-            vertexPushData.model = instance.modelMat;
-            vertexPushData.textureIndex = meshBuffer.texIndex;
-            vertexPushData.lightStrength = instance.lightStrength;
-
-            MaterialPushData materialPushData;
-            materialPushData.baseColor = material.baseColor;
-            materialPushData.metallic = material.metallic;
-            materialPushData.roughness = material.roughness;
-
-            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexPushData), &vertexPushData);
-
-            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, materialPushDataStructOffset, sizeof(MaterialPushData), &materialPushData);
-
-            std::array<VkDescriptorSet, 2> descriptorSetGroup = {modelPipeline.descriptorSets[currentFrame], textures.descriptorSets[meshBuffer.texIndex]};
-
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipeline.layout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
-
-            vkCmdDrawIndexed(commandBuffer, meshBuffer.indexCount, 1, 0, 0, 0);
-        };
-
-        struct TransparentMesh
-        {
-            const ModelInstance *instance;
-            const MeshBuffer *meshBuffer;
-            Material material;
-            float distanceSquared;
-        };
-        std::vector<TransparentMesh> transparentMeshes;
-
-        for (const ModelInstance &instance : modelInstances)
-        {
-            for (const ModelBuffer &modelBuffer : modelBuffers)
-            {
-                if (instance.modelHandle == modelBuffer.handle)
-                {
-                    for (const MeshBuffer &meshBuffer : modelBuffer.meshBuffers)
-                    {
-                        if (meshBuffer.isTransparent)
-                        {
-                            glm::vec3 meshWorldPosition = glm::vec3(instance.modelMat[3]);
-                            float distanceSquared = glm::dot(meshWorldPosition - cameraPosition, meshWorldPosition - cameraPosition);
-                            transparentMeshes.push_back({&instance, &meshBuffer, modelBuffer.materials[meshBuffer.materialIndex], distanceSquared});
-                            continue;
-                        }
-
-                        drawMesh(instance, meshBuffer, modelBuffer.materials[meshBuffer.materialIndex], modelPipeline.layout);
-                    }
-
-                    break;
-                }
-            }
-        }
-
-        if (!transparentMeshes.empty())
-        {
-            std::sort(transparentMeshes.begin(), transparentMeshes.end(),
-                      [](const TransparentMesh &leftMesh, const TransparentMesh &rightMesh)
-                      { return leftMesh.distanceSquared > rightMesh.distanceSquared; });
-
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, transparentPipeline.pipeline);
-
-            for (const TransparentMesh &mesh : transparentMeshes)
-                drawMesh(*mesh.instance, *mesh.meshBuffer, mesh.material, transparentPipeline.layout);
-        }
+        recordDrawRuns(commandBuffer, drawResources.opaqueRuns, modelPipeline.layout, offsetof(VertexPushData, firstDraw));
+        recordDrawRuns(commandBuffer, drawResources.transparentRuns, transparentPipeline.layout, offsetof(VertexPushData, firstDraw));
 
         vkCmdEndRendering(commandBuffer);
 
@@ -335,10 +735,7 @@ namespace VE
         UboUI uboUI;
         uboUI.orthographicProj = glm::ortho(0.f, (float)swapChainExtent.width, 0.f, (float)swapChainExtent.height);
 
-        void *uiData;
-        vkCheck(vkMapMemory(device, uiUniformBuffersMemory[currentFrame], 0, sizeof(UboUI), 0, &uiData), {'V', 236});
-        memcpy(uiData, &uboUI, sizeof(UboUI));
-        vkUnmapMemory(device, uiUniformBuffersMemory[currentFrame]);
+        memcpy(uiUniformBuffersMemory[currentFrame].mappedData, &uboUI, sizeof(UboUI));
     }
 
     void Renderer::recordUIPass(uint32_t currentImage, const std::vector<Widget> &widgets, const std::vector<WidgetInstance> &widgetInstances)
@@ -396,37 +793,30 @@ namespace VE
             .extent = swapChainExtent};
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        for (const WidgetInstance &instance : widgetInstances)
-        {
-            for (const WidgetBuffer &widgetBuffer : widgetBuffers)
-            {
-                if (instance.widgetHandle == widgetBuffer.handle)
-                {
-                    for (const MeshBuffer &meshBuffer : widgetBuffer.meshBuffers)
-                    {
-                        VkBuffer vertexBuffers[] = {meshBuffer.vertexBuffer};
-                        VkDeviceSize offsets[] = {0};
-                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-
-                        vkCmdBindIndexBuffer(commandBuffer, meshBuffer.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        std::array<VkDescriptorSet, 2> descriptorSetGroup = {uiPipeline.descriptorSets[currentFrame], textures.descriptorSet};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, uiPipeline.layout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
 
-                        UIPushData pushData;
-                        pushData.model = Transform(Position3((instance.coords.x + 1) / 2 * swapChainExtent.width, (instance.coords.y + 1) / 2 * swapChainExtent.height, 0.f), Rotation3(), Scale3(instance.uniformScale)).toMat();
+        GeometryBinding geometryBinding;
 
-                        pushData.textureIndex = meshBuffer.texIndex;
-                        pushData.model[1][1] *= -1;
+        for (const WidgetInstance &instance : widgetInstances)
+        {
+            const WidgetBuffer *widgetBuffer = findWidgetBuffer(instance.widgetHandle);
+            if (!widgetBuffer)
+                continue;
 
-                        vkCmdPushConstants(commandBuffer, uiPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(UIPushData), &pushData);
+            for (const MeshBuffer &meshBuffer : widgetBuffer->meshBuffers)
+            {
+                bindGeometry(commandBuffer, meshBuffer.geometryPageIndex, meshBuffer.indexType, geometryBinding);
 
-                        std::array<VkDescriptorSet, 2> descriptorSetGroup = {uiPipeline.descriptorSets[currentFrame], textures.descriptorSets[meshBuffer.texIndex]};
+                UIPushData pushData;
+                pushData.model = Transform(Position3((instance.coords.x + 1) / 2 * swapChainExtent.width, (instance.coords.y + 1) / 2 * swapChainExtent.height, 0.f), Rotation3(), Scale3(instance.uniformScale)).toMat();
 
-                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, uiPipeline.layout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+                pushData.textureIndex = textureDescriptorIndex(meshBuffer.texIndex);
+                pushData.model[1][1] *= -1;
 
-                        vkCmdDrawIndexed(commandBuffer, meshBuffer.indexCount, 1, 0, 0, 0);
-                    }
+                vkCmdPushConstants(commandBuffer, uiPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(UIPushData), &pushData);
 
-                    break;
-                }
+                vkCmdDrawIndexed(commandBuffer, meshBuffer.indexCount, 1, meshBuffer.firstIndex, meshBuffer.vertexOffset, 0);
             }
         }
 
@@ -454,34 +844,39 @@ namespace VE
 
         vkCheck(vkResetFences(device, 1, &frames[currentFrame].drawFence), {'V', 232});
 
-        if (sceneDrawData.modelRemovedThisFrame)
         {
             std::lock_guard<std::recursive_mutex> lock(modelMutex);
-            removeOrphanedModel(sceneDrawData.modelInstances);
+            destroyRetiredMeshBuffers();
+            destroyRetiredTextures();
+
+            if (sceneDrawData.modelRemovedThisFrame)
+                removeOrphanedModel(sceneDrawData.modelInstances);
         }
 
-        glm::vec4 lightPos(0.0f);
-        glm::vec3 lightColor(1.0f);
-        for (const ModelInstance &instance : sceneDrawData.modelInstances)
+        lightResources.pointLights.clear();
         {
-            for (const Model &model : sceneDrawData.models)
+            std::lock_guard<std::recursive_mutex> lock(modelMutex);
+
+            for (const ModelInstance &instance : sceneDrawData.modelInstances)
             {
-                if (model.getHandle() == instance.modelHandle)
-                {
-                    lightPos = glm::vec4(glm::vec3(instance.modelMat[3]), instance.lightStrength);
-                    lightColor = instance.lightColor;
-                    break;
-                }
+                if (instance.lightStrength <= 0.0f || !findModelBuffer(instance.modelHandle))
+                    continue;
+
+                const glm::vec3 position(instance.modelMat[3]);
+                const float radius = std::sqrt(instance.lightStrength / POINT_LIGHT_CUTOFF);
+                lightResources.pointLights.push_back({glm::vec4(position, radius), glm::vec4(glm::vec3(instance.lightColor), instance.lightStrength)});
             }
-            if (lightPos.w > 0.0f)
-                break;
         }
 
-        glm::mat4 lightView = glm::lookAt(glm::vec3(lightPos), glm::vec3(0.0f), glm::vec3(0, 1, 0));
-        glm::mat4 lightProjection = glm::orthoZO(-50.f, 50.f, -50.f, 50.f, 1.f, 200.f);
-        glm::mat4 lightSpaceMat = lightProjection * lightView;
+        glm::vec4 clusterParams;
+        updateLightClusters(currentFrame, projectionMat, sceneDrawData.viewMat, clusterParams);
 
-        updateModelUniformBuffers(currentFrame, projectionMat, sceneDrawData.viewMat, lightPos, lightColor, lightSpaceMat, sceneDrawData.outdoorBrightness);
+        // Only the environment's sun casts the cascaded shadows, emissive instances are all point lights
+        // Without it the shaders skip the sun entirely, so the cascades keep their last fit and nothing is drawn into them
+        const bool hasSun = sceneDrawData.sunStrength > 0.0f;
+        const ShadowCascades &shadowCascades = hasSun ? updateShadowCascades(projectionMat, sceneDrawData.viewMat, sceneDrawData.sunDirection, sceneDrawData.staticInstanceVersion) : shadowCache.cascades;
+
+        updateModelUniformBuffers(currentFrame, projectionMat, sceneDrawData.viewMat, glm::vec4(sceneDrawData.sunDirection, sceneDrawData.sunStrength), glm::vec3(sceneDrawData.sunColor), shadowCascades, clusterParams, sceneDrawData.outdoorBrightness);
         updateUIUniformBuffers(currentFrame);
 
         const VkCommandBuffer commandBuffer = frames[currentFrame].commandBuffer;
@@ -495,29 +890,69 @@ namespace VE
             std::lock_guard<std::recursive_mutex> lock(modelMutex);
             syncModelBuffers(sceneDrawData.models);
 
-            recordShadowPass(sceneDrawData.models, sceneDrawData.modelInstances, lightSpaceMat);
+            // Swaps in finished mip chains, whose acquires are recorded below, and queues the next ones
+            updateTextureStreaming(sceneDrawData.modelInstances, projectionMat, sceneDrawData.viewMat);
+        }
+        {
+            std::lock_guard<std::recursive_mutex> lock(widgetMutex);
+            syncWidgetBuffers(uiDrawData.widgets);
+        }
+
+        // Everything published above has its acquires queued by now
+        const uint64_t uploadTimelineValue = recordUploadAcquires(commandBuffer);
+
+        {
+            std::lock_guard<std::recursive_mutex> lock(modelMutex);
+
+            // The model loader grows the geometry pages and texture sets while we record
+            std::scoped_lock resourceLock(geometryMutex, textureMutex);
+
+            updateInstanceBuffer(currentFrame, sceneDrawData.modelInstances);
+
+            const Frustum cameraFrustum = extractFrustum(projectionMat * sceneDrawData.viewMat);
+
+            updateDrawBuffers(currentFrame, glm::vec3(glm::inverse(sceneDrawData.viewMat)[3]), cameraFrustum, hasSun);
+
+            recordCullingPass(cameraFrustum, shadowCascades);
 
-            recordMainPass(imageIndex, sceneDrawData.models, sceneDrawData.modelInstances, sceneDrawData.backgroundColor, lightSpaceMat, glm::vec3(glm::inverse(sceneDrawData.viewMat)[3]));
+            if (hasSun)
+                recordShadowPass(sceneDrawData.models, shadowCascades);
+            else
+                recordUnlitShadowMap();
+
+            recordMainPass(imageIndex, sceneDrawData.models, sceneDrawData.backgroundColor);
         }
 
         recordPostPass(imageIndex, postEffects);
 
         {
             std::lock_guard<std::recursive_mutex> lock(widgetMutex);
-            syncWidgetBuffers(uiDrawData.widgets);
+
+            std::scoped_lock resourceLock(geometryMutex, textureMutex);
 
             recordUIPass(imageIndex, uiDrawData.widgets, uiDrawData.widgetInstances);
         }
 
         vkCheck(vkEndCommandBuffer(commandBuffer), {'V', 213});
 
-        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        std::array<VkSemaphore, 2> waitSemaphores = {frames[currentFrame].imageAvailableSemaphore, uploadTimeline.semaphore};
+        std::array<VkPipelineStageFlags, 2> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT};
+        std::array<uint64_t, 2> waitValues = {0, uploadTimelineValue};
+
+        // Only frames that acquired uploads wait on the transfer queue
+        const uint32_t waitSemaphoreCount = uploadTimelineValue > 0 ? 2 : 1;
+
+        VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = waitSemaphoreCount,
+            .pWaitSemaphoreValues = waitValues.data()};
 
         VkSubmitInfo submitInfo = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &frames[currentFrame].imageAvailableSemaphore,
-            .pWaitDstStageMask = &waitStage,
+            .pNext = &timelineSubmitInfo,
+            .waitSemaphoreCount = waitSemaphoreCount,
+            .pWaitSemaphores = waitSemaphores.data(),
+            .pWaitDstStageMask = waitStages.data(),
             .commandBufferCount = 1,
             .pCommandBuffers = &commandBuffer,
             .signalSemaphoreCount = 1,
@@ -547,6 +982,7 @@ namespace VE
         }
 
         currentFrame = (currentFrame + 1) % FRAMES_IN_FLIGHT;
+        frameIndex++;
     }
 
     void Renderer::recreateSwapChain()
@@ -559,7 +995,10 @@ namespace VE
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(device);
+        {
+            std::scoped_lock lock(graphicsQueueMutex, transferQueueMutex);
+            vkDeviceWaitIdle(device);
+        }
 
         if (swapChain)
         {
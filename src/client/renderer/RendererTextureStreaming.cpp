@@ -0,0 +1,348 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#include "Renderer.hpp"
+
+#include "../../shared/AssetFormat.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace VE
+{
+    void Renderer::updateTextureStreaming(const std::vector<ModelInstance> &modelInstances, const glm::mat4 &projectionMat, const glm::mat4 &viewMat)
+    {
+        publishStreamedTextures();
+
+        std::vector<UploadJob> streamJobs;
+        {
+            std::lock_guard<std::mutex> lock(textureMutex);
+
+            std::vector<TextureStream> &streams = textures.streams;
+
+            for (TextureStream &stream : streams)
+            {
+                if (!stream.isStreamed)
+                    continue;
+
+                stream.wantedLevel = stream.isPinned ? 0 : static_cast<uint32_t>(stream.mipTailBytes.size()) - 1;
+                stream.isReferenced = false;
+            }
+
+            // Screen pixels one world unit covers at a distance of one
+            const float pixelsPerUnit = projectionMat[1][1] * 0.5f * static_cast<float>(swapChainExtent.height);
+            const glm::vec3 cameraPos = glm::vec3(glm::inverse(viewMat)[3]);
+
+            for (const ModelInstance &instance : modelInstances)
+            {
+                const ModelBuffer *modelBuffer = findModelBuffer(instance.modelHandle);
+                if (!modelBuffer)
+                    continue;
+
+                const float scale = glm::length(glm::vec3(instance.modelMat[0]));
+
+                for (const MeshBuffer &meshBuffer : modelBuffer->meshBuffers)
+                {
+                    if (meshBuffer.texIndex == INVALID_TEXTURE_INDEX || !streams[meshBuffer.texIndex].isStreamed)
+                        continue;
+
+                    TextureStream &stream = streams[meshBuffer.texIndex];
+                    stream.isReferenced = true;
+
+                    if (meshBuffer.uvDensity <= 0.0f)
+                        continue;
+
+                    const glm::vec3 center = glm::vec3(instance.modelMat * glm::vec4(meshBuffer.bounds.center, 1.0f));
+                    const float distance = std::max(glm::length(center - cameraPos) - meshBuffer.bounds.radius * scale, TEXTURE_STREAMING_MIN_DISTANCE);
+
+                    // Texels of the largest level per screen pixel, every doubling of it skips a level
+                    const float texelsPerPixel = stream.size * meshBuffer.uvDensity * distance / (scale * pixelsPerUnit);
+                    const uint32_t level = static_cast<uint32_t>(std::max(std::log2(texelsPerPixel), 0.0f));
+
+                    stream.wantedLevel = std::min(stream.wantedLevel, level);
+                }
+            }
+
+            // Bytes every texture holds once its pending job lands
+            VkDeviceSize committedBytes = 0;
+            std::vector<uint32_t> upgrades;
+            std::vector<uint32_t> downgrades;
+
+            for (uint32_t texIndex = 0; texIndex < streams.size(); texIndex++)
+            {
+                const TextureStream &stream = streams[texIndex];
+                if (!stream.isStreamed)
+                    continue;
+
+                if (stream.requestedLevel != UINT32_MAX)
+                {
+                    committedBytes += stream.mipTailBytes[stream.requestedLevel];
+                    continue;
+                }
+
+                committedBytes += stream.mipTailBytes[stream.residentLevel];
+
+                if (frameIndex < stream.streamableFrameIndex)
+                    continue;
+
+                if (stream.wantedLevel < stream.residentLevel)
+                    upgrades.push_back(texIndex);
+                else if (stream.wantedLevel > stream.residentLevel && stream.isReferenced)
+                    downgrades.push_back(texIndex);
+            }
+
+            // Furthest below their demand first, and the most surplus detail is evicted first
+            std::sort(upgrades.begin(), upgrades.end(), [&](uint32_t left, uint32_t right)
+                      { return streams[left].residentLevel - streams[left].wantedLevel > streams[right].residentLevel - streams[right].wantedLevel; });
+            std::sort(downgrades.begin(), downgrades.end(), [&](uint32_t left, uint32_t right)
+                      { return streams[left].wantedLevel - streams[left].residentLevel > streams[right].wantedLevel - streams[right].residentLevel; });
+
+            size_t nextDowngrade = 0;
+
+            for (uint32_t texIndex : upgrades)
+            {
+                if (textures.streamingJobCount >= TEXTURE_STREAMING_MAX_JOBS)
+                    break;
+
+                const TextureStream &stream = streams[texIndex];
+                const VkDeviceSize residentBytes = stream.mipTailBytes[stream.residentLevel];
+
+                // Textures nobody is close to give up their top levels only when the budget needs the room
+                while (committedBytes + stream.mipTailBytes[stream.wantedLevel] - residentBytes > TEXTURE_STREAMING_BUDGET &&
+                       nextDowngrade < downgrades.size() && textures.streamingJobCount + 1 < TEXTURE_STREAMING_MAX_JOBS)
+                {
+                    const uint32_t evictedIndex = downgrades[nextDowngrade++];
+                    const TextureStream &evicted = streams[evictedIndex];
+
+                    committedBytes -= evicted.mipTailBytes[evicted.residentLevel] - evicted.mipTailBytes[evicted.wantedLevel];
+                    evictTextureLevels(evictedIndex, evicted.wantedLevel);
+                }
+
+                // Short of the budget, take the most detail that still fits
+                uint32_t level = stream.wantedLevel;
+                while (level < stream.residentLevel && committedBytes + stream.mipTailBytes[level] - residentBytes > TEXTURE_STREAMING_BUDGET)
+                    level++;
+
+                if (level == stream.residentLevel)
+                    continue;
+
+                committedBytes += stream.mipTailBytes[level] - residentBytes;
+                streamJobs.push_back(createTextureStreamJob(texIndex, level));
+            }
+        }
+
+        // Outside the texture lock, the workers take it while this waits for queue space
+        for (UploadJob &job : streamJobs)
+            submitUploadJob(std::move(job));
+    }
+
+    Renderer::UploadJob Renderer::createTextureStreamJob(uint32_t texIndex, uint32_t level)
+    {
+        TextureStream &stream = textures.streams[texIndex];
+        stream.requestedLevel = level;
+        textures.streamingJobCount++;
+
+        const uint32_t generation = stream.generation;
+        const uint32_t residentLevel = stream.residentLevel;
+        const uint32_t mipLevelCount = static_cast<uint32_t>(stream.mipTailBytes.size()) - level;
+        const uint32_t width = stream.width;
+        const uint32_t height = stream.height;
+        const CookedTextureFormat format = stream.format;
+
+        // Alive until this job's chain is published, or until the texture is released and the tail copy skipped
+        const ImageAttachment resident = textures.attachments[texIndex];
+
+        // Only the missing top levels are read, the resident ones are copied over from the old chain on the GPU
+        std::shared_future<DecodedImage> decoded = decodeTextureLevels(textures.filePaths[texIndex], level, residentLevel - level);
+
+        return [this, texIndex, generation, level, residentLevel, mipLevelCount, width, height, format, resident, decoded](UploadContext &context)
+        {
+            StreamedTexture streamed = {texIndex, generation, level, {}};
+
+            // The file may have been cooked again since it was loaded, its levels must still fit the old chain
+            const std::shared_ptr<CookedTexture> cookedTexture = decoded.get().cookedTexture;
+            if (cookedTexture && cookedTexture->width == width && cookedTexture->height == height && cookedTexture->format == format &&
+                cookedTexture->mipLevels.size() == residentLevel - level)
+            {
+                UploadBatch uploadBatch;
+                beginUploadBatch(context, uploadBatch);
+
+                streamed.attachment = uploadCookedMipLevels(uploadBatch, *cookedTexture, 0, mipLevelCount);
+                if (streamed.attachment.image)
+                    uploadBatch.acquires.mipTailCopies.push_back({texIndex, generation, resident.image, 0, streamed.attachment.image, residentLevel - level, mipLevelCount - (residentLevel - level),
+                                                                  std::max(width >> residentLevel, 1u), std::max(height >> residentLevel, 1u)});
+
+                endUploadBatch(uploadBatch);
+
+                if (streamed.attachment.image)
+                    streamed.attachment.imageView = createTextureView(streamed.attachment);
+            }
+            else
+            {
+                Log::add('V', 112);
+            }
+
+            std::lock_guard<std::mutex> lock(completedUploads.mutex);
+            completedUploads.textures.push_back(streamed);
+        };
+    }
+
+    // Every level kept is resident already, so the new chain is copied out of the old one into this frame's commands,
+    // with no file read or transfer queue upload, and published next frame like a finished stream job
+    void Renderer::evictTextureLevels(uint32_t texIndex, uint32_t level)
+    {
+        TextureStream &stream = textures.streams[texIndex];
+        stream.requestedLevel = level;
+        textures.streamingJobCount++;
+
+        const ImageAttachment &resident = textures.attachments[texIndex];
+
+        const uint32_t mipLevelCount = static_cast<uint32_t>(stream.mipTailBytes.size()) - level;
+        const uint32_t width = std::max(stream.width >> level, 1u);
+        const uint32_t height = std::max(stream.height >> level, 1u);
+
+        StreamedTexture streamed = {texIndex, stream.generation, level, {}};
+        streamed.attachment.image = createImage(width, height, resident.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevelCount, 1, &streamed.attachment.memory);
+        streamed.attachment.mipLevelCount = mipLevelCount;
+        streamed.attachment.format = resident.format;
+        streamed.attachment.imageView = createTextureView(streamed.attachment);
+
+        recordMipTailCopy(frames[currentFrame].commandBuffer, {texIndex, stream.generation, resident.image, level - stream.residentLevel, streamed.attachment.image, 0, mipLevelCount, width, height});
+
+        std::lock_guard<std::mutex> lock(completedUploads.mutex);
+        completedUploads.textures.push_back(streamed);
+    }
+
+    void Renderer::recordMipTailCopy(VkCommandBuffer commandBuffer, const MipTailCopy &tailCopy)
+    {
+        const VkImageSubresourceRange srcRange = {VK_IMAGE_ASPECT_COLOR_BIT, tailCopy.srcFirstLevel, tailCopy.levelCount, 0, 1};
+
+        // Frames in flight sampling the old chain came before this on the graphics queue, and the new chain's tail was never written
+        const std::array<VkImageMemoryBarrier, 2> copyBarriers = {
+            VkImageMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = tailCopy.srcImage,
+                .subresourceRange = srcRange},
+            VkImageMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = tailCopy.dstImage,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, tailCopy.dstFirstLevel, tailCopy.levelCount, 0, 1}}};
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(copyBarriers.size()), copyBarriers.data());
+
+        // Whole levels, which is also what block compressed formats need at the small end of the chain
+        std::vector<VkImageCopy> imageCopies;
+        imageCopies.reserve(tailCopy.levelCount);
+        for (uint32_t mipIndex = 0; mipIndex < tailCopy.levelCount; mipIndex++)
+            imageCopies.push_back({.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, tailCopy.srcFirstLevel + mipIndex, 0, 1},
+                                   .srcOffset = {0, 0, 0},
+                                   .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, tailCopy.dstFirstLevel + mipIndex, 0, 1},
+                                   .dstOffset = {0, 0, 0},
+                                   .extent = {std::max(tailCopy.width >> mipIndex, 1u), std::max(tailCopy.height >> mipIndex, 1u), 1}});
+
+        vkCmdCopyImage(commandBuffer, tailCopy.srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, tailCopy.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       static_cast<uint32_t>(imageCopies.size()), imageCopies.data());
+
+        // The levels above the tail were acquired in transfer layout, so the whole new chain moves to sampling here
+        const std::array<VkImageMemoryBarrier, 2> sampleBarriers = {
+            VkImageMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = tailCopy.srcImage,
+                .subresourceRange = srcRange},
+            VkImageMemoryBarrier{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = tailCopy.dstImage,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, tailCopy.dstFirstLevel + tailCopy.levelCount, 0, 1}}};
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(sampleBarriers.size()), sampleBarriers.data());
+    }
+
+    void Renderer::publishStreamedTextures()
+    {
+        std::vector<StreamedTexture> completed;
+        {
+            std::lock_guard<std::mutex> lock(completedUploads.mutex);
+            completed.swap(completedUploads.textures);
+        }
+
+        if (completed.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(textureMutex);
+
+        std::vector<StreamedTexture> deferred;
+
+        for (StreamedTexture &streamed : completed)
+        {
+            TextureStream &stream = textures.streams[streamed.texIndex];
+            const bool isCurrent = stream.generation == streamed.generation;
+
+            // The other descriptor may still be sampled by a frame in flight since the previous swap
+            if (isCurrent && stream.isStreamed && streamed.attachment.image && stream.swapFrameIndex + FRAMES_IN_FLIGHT > frameIndex)
+            {
+                deferred.push_back(streamed);
+                continue;
+            }
+
+            textures.streamingJobCount--;
+
+            if (isCurrent)
+                stream.requestedLevel = UINT32_MAX;
+
+            // Released while streaming or failed to load, its acquire is already queued so it is retired like a drawn one
+            if (!isCurrent || !stream.isStreamed || !streamed.attachment.image)
+            {
+                textures.retired.push_back({streamed.attachment, INVALID_TEXTURE_INDEX, frameIndex});
+                continue;
+            }
+
+            // Frames in flight keep sampling the previous chain through the other descriptor
+            textures.retired.push_back({textures.attachments[streamed.texIndex], INVALID_TEXTURE_INDEX, frameIndex});
+
+            textures.attachments[streamed.texIndex] = streamed.attachment;
+
+            stream.usesSecondDescriptor = !stream.usesSecondDescriptor;
+            stream.swapFrameIndex = frameIndex;
+            writeTextureDescriptor(textureDescriptorIndex(streamed.texIndex), streamed.attachment.imageView);
+
+            stream.residentLevel = streamed.firstLevel;
+
+            // Its acquire is recorded by this frame at the latest, after the streaming pass
+            stream.streamableFrameIndex = frameIndex + 1;
+        }
+
+        if (!deferred.empty())
+        {
+            std::lock_guard<std::mutex> completedLock(completedUploads.mutex);
+            completedUploads.textures.insert(completedUploads.textures.end(), deferred.begin(), deferred.end());
+        }
+    }
+}
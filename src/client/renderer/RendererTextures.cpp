@@ -6,197 +6,100 @@
 #include "Renderer.hpp"
 
 #include "../../shared/Log.hpp"
+#include "../../shared/AssetFormat.hpp"
+#include "../../shared/local.hpp"
 
 #include "../../../ext/stb_image/stb_image.h"
 
+#include <algorithm>
+#include <chrono>
+
 namespace VE
 {
-    VkResult copyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height, std::mutex &transferQueueMutex, VkFence fence)
+    VkBufferImageCopy imageCopyRegion(VkDeviceSize bufferOffset, uint32_t mipLevel, uint32_t width, uint32_t height)
     {
-        VkCommandBufferAllocateInfo allocInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            .commandPool = transferCommandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1};
-
-        VkCommandBuffer transferCommandBuffer;
-
-        VkResult res = vkAllocateCommandBuffers(device, &allocInfo, &transferCommandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkCommandBufferBeginInfo beginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        };
-
-        res = vkBeginCommandBuffer(transferCommandBuffer, &beginInfo);
-        if (res != VK_SUCCESS)
-            return res;
-
         VkBufferImageCopy imageRegion = {};
-        imageRegion.bufferOffset = 0;
+        imageRegion.bufferOffset = bufferOffset;
         imageRegion.bufferRowLength = 0;
         imageRegion.bufferImageHeight = 0;
         imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageRegion.imageSubresource.mipLevel = 0;
+        imageRegion.imageSubresource.mipLevel = mipLevel;
         imageRegion.imageSubresource.baseArrayLayer = 0;
         imageRegion.imageSubresource.layerCount = 1;
         imageRegion.imageOffset = {0, 0, 0};
         imageRegion.imageExtent = {width, height, 1};
 
-        vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
-
-        res = vkEndCommandBuffer(transferCommandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &transferCommandBuffer};
-
-        {
-            std::lock_guard<std::mutex> lock(transferQueueMutex);
-            res = vkQueueSubmit(transferQueue, 1, &submitInfo, fence);
-            if (res != VK_SUCCESS)
-                return res;
-        }
-
-        res = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-        if (res != VK_SUCCESS)
-            return res;
-
-        vkFreeCommandBuffers(device, transferCommandPool, 1, &transferCommandBuffer);
-
-        return VK_SUCCESS;
+        return imageRegion;
     }
 
-    VkResult transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, std::mutex &graphicsQueueMutex, VkFence fence)
+    VkFormat cookedTextureVkFormat(CookedTextureFormat format)
     {
-        VkCommandBufferAllocateInfo allocInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            .commandPool = commandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1};
-
-        VkCommandBuffer commandBuffer;
-
-        VkResult res = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkCommandBufferBeginInfo beginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        };
-
-        res = vkBeginCommandBuffer(commandBuffer, &beginInfo);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkImageMemoryBarrier imageMemoryBarrier = {};
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.oldLayout = oldLayout;
-        imageMemoryBarrier.newLayout = newLayout;
-        imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.image = image;
-        imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-        imageMemoryBarrier.subresourceRange.levelCount = 1;
-        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags srcStage;
-        VkPipelineStageFlags dstStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-        {
-            imageMemoryBarrier.srcAccessMask = 0;
-            imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        }
-        else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-
-        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-
-        res = vkEndCommandBuffer(commandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffer};
-
+        switch (format)
         {
-            std::lock_guard<std::mutex> lock(graphicsQueueMutex);
-            res = vkQueueSubmit(queue, 1, &submitInfo, fence);
-            if (res != VK_SUCCESS)
-                return res;
+        case COOKED_TEXTURE_FORMAT_BC1:
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case COOKED_TEXTURE_FORMAT_BC3:
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case COOKED_TEXTURE_FORMAT_BC7:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_R8G8B8A8_UNORM;
         }
-
-        res = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-        if (res != VK_SUCCESS)
-            return res;
-
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-
-        return VK_SUCCESS;
     }
 
-    void Renderer::createTextureDescriptorSetLayout()
+    void Renderer::createTextureDescriptors()
     {
         VkDescriptorSetLayoutBinding samplerLayoutBinding = {
             .binding = 0,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = 1,
+            .descriptorCount = 2 * MAX_TEXTURE_COUNT,
             .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
             .pImmutableSamplers = nullptr};
 
+        // Slots are written while earlier frames still sample other slots and unwritten ones are never read.
+        // Every texture has two, see TextureStream
+        const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = 1,
+            .pBindingFlags = &bindingFlags};
+
         VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &bindingFlagsCreateInfo,
+            .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
             .bindingCount = 1,
             .pBindings = &samplerLayoutBinding};
 
         vkCheck(vkCreateDescriptorSetLayout(device, &textureLayoutCreateInfo, nullptr, &textures.descriptorSetLayout), {'V', 217});
-    }
 
-    VkResult generateMipmaps(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue queue, VkCommandPool commandPool, VkImage image, VkFormat imageFormat, int32_t textureWidth, int32_t textureHeight, uint32_t mipLevelCount, std::mutex &graphicsQueueMutex, VkFence fence)
-    {
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
-            return VK_ERROR_FEATURE_NOT_PRESENT;
+        VkDescriptorPoolSize poolSize = {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 2 * MAX_TEXTURE_COUNT};
 
-        VkCommandBufferAllocateInfo allocInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            .commandPool = commandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1};
+        VkDescriptorPoolCreateInfo poolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets = 1,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize};
 
-        VkCommandBuffer commandBuffer;
-        VkResult res = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
+        vkCheck(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &textures.descriptorPool), {'V', 219});
 
-        VkCommandBufferBeginInfo beginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+        VkDescriptorSetAllocateInfo setAllocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = textures.descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &textures.descriptorSetLayout};
 
-        res = vkBeginCommandBuffer(commandBuffer, &beginInfo);
-        if (res != VK_SUCCESS)
-            return res;
+        vkCheck(vkAllocateDescriptorSets(device, &setAllocInfo, &textures.descriptorSet), {'V', 220});
+    }
+
+    void Renderer::recordMipmapGeneration(VkCommandBuffer commandBuffer, const MipmapGeneration &mipmapGeneration)
+    {
+        const VkImage image = mipmapGeneration.image;
+        const uint32_t mipLevelCount = mipmapGeneration.mipLevelCount;
 
         VkImageMemoryBarrier barrier = {};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -221,8 +124,8 @@ namespace VE
             vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &initBarrier);
         }
 
-        int32_t currentMipWidth = textureWidth;
-        int32_t currentMipHeight = textureHeight;
+        int32_t currentMipWidth = mipmapGeneration.width;
+        int32_t currentMipHeight = mipmapGeneration.height;
 
         for (uint32_t mipIndex = 1; mipIndex < mipLevelCount; mipIndex++)
         {
@@ -273,62 +176,25 @@ namespace VE
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
         vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        res = vkEndCommandBuffer(commandBuffer);
-        if (res != VK_SUCCESS)
-            return res;
-
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffer};
-
-        {
-            std::lock_guard<std::mutex> lock(graphicsQueueMutex);
-            res = vkQueueSubmit(queue, 1, &submitInfo, fence);
-            if (res != VK_SUCCESS)
-                return res;
-        }
-
-        res = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-        if (res != VK_SUCCESS)
-            return res;
-
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-
-        return VK_SUCCESS;
     }
 
     void Renderer::createFallbackTexture()
     {
+        UploadContext context = createUploadContext();
+
         uint32_t whitePixel = 0xFFFFFFFF;
         VkDeviceSize imageSize = 4;
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
-
-        void *data;
-        vkCheck(vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data), {'V', 236});
-        memcpy(data, &whitePixel, imageSize);
-        vkUnmapMemory(device, stagingBufferMemory);
-
         VkImage texImage;
-        VkDeviceMemory texImageMemory;
-        texImage = createImage(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, &texImageMemory);
+        MemoryAllocation texImageMemory;
+        texImage = createImage(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, 1, &texImageMemory);
 
-        CommandPoolGuard graphicsCommandPoolLocal(device, graphicsQueueFamilyIndex);
-        CommandPoolGuard transferCommandPoolLocal(device, transferQueueFamilyIndex);
+        UploadBatch uploadBatch;
+        beginUploadBatch(context, uploadBatch);
 
-        VkFence uploadFence = VK_NULL_HANDLE;
-        VkFenceCreateInfo fenceCreateInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-        vkCheck(vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence), {'V', 216});
-
-        vkCheck(transitionImageLayout(device, graphicsQueue, graphicsCommandPoolLocal, texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, graphicsQueueMutex, uploadFence), {'V', 240});
-        vkCheck(vkResetFences(device, 1, &uploadFence), {'V', 232});
-        vkCheck(copyImageBuffer(device, transferQueue, transferCommandPoolLocal, stagingBuffer, texImage, 1, 1, transferQueueMutex, uploadFence), {'V', 239});
-        vkCheck(vkResetFences(device, 1, &uploadFence), {'V', 232});
-        vkCheck(transitionImageLayout(device, graphicsQueue, graphicsCommandPoolLocal, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, graphicsQueueMutex, uploadFence), {'V', 240});
+        uploadImage(uploadBatch, texImage, &whitePixel, imageSize, {imageCopyRegion(0, 0, 1, 1)});
+        releaseImage(uploadBatch, texImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+        endUploadBatch(uploadBatch);
 
         VkImageViewCreateInfo imageViewCreateInfo{};
         imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -344,160 +210,305 @@ namespace VE
         {
             std::lock_guard<std::mutex> lock(textureMutex);
             textures.attachments.push_back({texImage, texImageMemory, imageView});
-            (void)createTextureDescriptor(imageView);
-        }
+            textures.filePaths.emplace_back();
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+            // Draws read a slot's stream without the mutex, so the vector never reallocates
+            textures.streams.reserve(MAX_TEXTURE_COUNT);
+            textures.streams.emplace_back();
+            writeTextureDescriptor(INVALID_TEXTURE_INDEX, imageView);
+        }
 
-        vkDestroyFence(device, uploadFence, nullptr);
+        destroyUploadContext(context);
     }
 
-    size_t Renderer::createTextureImage(std::string fileName)
+    ImageAttachment Renderer::createTextureImage(UploadBatch &batch, const std::string &fileName, bool allowStreaming, TextureStream &stream)
     {
-        int width, height;
-        VkDeviceSize imageSize;
+        DecodedImage decoded = takeDecodedImage(fileName);
 
-        stbi_uc *imageData = stbi_load(fileName.c_str(), &width, &height, nullptr, STBI_rgb_alpha);
+        if (decoded.cookedTexture)
+            return createCookedTextureImage(batch, *decoded.cookedTexture, allowStreaming, stream);
 
-        imageSize = width * height * STBI_rgb_alpha;
+        if (COOKED_ASSETS_ONLY)
+        {
+            Log::add('E', 101);
+            return {};
+        }
 
-        if(!imageData)
+        if (!decoded.pixels)
         {
             Log::add('V', 111);
-            return INVALID_TEXTURE_INDEX;
+            return {};
         }
 
-        uint32_t mipLevelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
-
-        VkBuffer imageStagingBuffer;
-        VkDeviceMemory imageStagingBufferMemory;
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &imageStagingBuffer, &imageStagingBufferMemory);
+        const int width = static_cast<int>(decoded.width);
+        const int height = static_cast<int>(decoded.height);
+        const VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * STBI_rgb_alpha;
 
-        void *data;
-        vkCheck(vkMapMemory(device, imageStagingBufferMemory, 0, imageSize, 0, &data), {'V', 236});
-        memcpy(data, imageData, static_cast<size_t>(imageSize));
-        vkUnmapMemory(device, imageStagingBufferMemory);
+        uint32_t mipLevelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 
-        stbi_image_free(imageData);
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+            Log::add('V', 241);
 
         VkImage texImage;
-        VkDeviceMemory texImageMemory;
+        MemoryAllocation texImageMemory;
 
-        texImage = createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevelCount, &texImageMemory);
+        texImage = createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevelCount, 1, &texImageMemory);
 
-        CommandPoolGuard graphicsCommandPoolLocal(device, graphicsQueueFamilyIndex);
-        CommandPoolGuard transferCommandPoolLocal(device, transferQueueFamilyIndex);
+        uploadImage(batch, texImage, decoded.pixels.get(), imageSize, {imageCopyRegion(0, 0, width, height)});
 
-        VkFence uploadFence = VK_NULL_HANDLE;
-        VkFenceCreateInfo fenceCreateInfo = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-        vkCheck(vkCreateFence(device, &fenceCreateInfo, nullptr, &uploadFence), {'V', 216});
+        // The transfer queue cannot blit, the graphics queue builds the chain when it acquires the image
+        releaseImage(batch, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+        batch.acquires.mipmapGenerations.push_back({texImage, width, height, mipLevelCount});
 
-        vkCheck(transitionImageLayout(device, graphicsQueue, graphicsCommandPoolLocal, texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, graphicsQueueMutex, uploadFence), {'V', 240});
-        vkCheck(vkResetFences(device, 1, &uploadFence), {'V', 232});
-        vkCheck(copyImageBuffer(device, transferQueue, transferCommandPoolLocal, imageStagingBuffer, texImage, width, height, transferQueueMutex, uploadFence), {'V', 239});
-        vkCheck(vkResetFences(device, 1, &uploadFence), {'V', 232});
-        vkCheck(generateMipmaps(device, physicalDevice, graphicsQueue, graphicsCommandPoolLocal, texImage, VK_FORMAT_R8G8B8A8_UNORM, width, height, mipLevelCount, graphicsQueueMutex, uploadFence), {'V', 241});
+        return {texImage, texImageMemory, VK_NULL_HANDLE, mipLevelCount};
+    }
 
-        size_t resultIndex;
+    ImageAttachment Renderer::createCookedTextureImage(UploadBatch &batch, const CookedTexture &cookedTexture, bool allowStreaming, TextureStream &stream)
+    {
+        if (cookedTexture.mipLevels.empty())
         {
-            std::lock_guard<std::mutex> lock(textureMutex);
-            textures.attachments.push_back({texImage, texImageMemory, VK_NULL_HANDLE, mipLevelCount});
-            resultIndex = textures.attachments.size() - 1;
+            Log::add('V', 112);
+            return {};
         }
 
-        vkDestroyBuffer(device, imageStagingBuffer, nullptr);
-        vkFreeMemory(device, imageStagingBufferMemory, nullptr);
+        const uint32_t mipLevelCount = static_cast<uint32_t>(cookedTexture.mipLevels.size());
 
-        vkDestroyFence(device, uploadFence, nullptr);
+        // Start from the largest level that fits the initial size, updateTextureStreaming brings in the rest
+        uint32_t firstLevel = 0;
+        if (allowStreaming)
+        {
+            while (firstLevel + 1 < mipLevelCount && std::max(cookedTexture.mipLevels[firstLevel].width, cookedTexture.mipLevels[firstLevel].height) > TEXTURE_STREAMING_INITIAL_SIZE)
+                firstLevel++;
+
+            stream.isStreamed = firstLevel > 0;
+        }
 
-        return resultIndex;
+        if (stream.isStreamed)
+        {
+            stream.size = std::max(cookedTexture.width, cookedTexture.height);
+            stream.width = cookedTexture.width;
+            stream.height = cookedTexture.height;
+            stream.format = cookedTexture.format;
+            stream.residentLevel = firstLevel;
+
+            stream.mipTailBytes.resize(mipLevelCount);
+            for (uint32_t mipIndex = 0; mipIndex < mipLevelCount; mipIndex++)
+                stream.mipTailBytes[mipIndex] = cookedTexture.data.size() - cookedTexture.mipLevels[mipIndex].offset;
+        }
+
+        return uploadCookedMipLevels(batch, cookedTexture, firstLevel, mipLevelCount - firstLevel);
     }
 
-    size_t Renderer::createTexture(std::string fileName)
+    // Levels past the ones loaded are left for a MipTailCopy, and the image is released still in transfer layout for it
+    ImageAttachment Renderer::uploadCookedMipLevels(UploadBatch &batch, const CookedTexture &cookedTexture, uint32_t firstLevel, uint32_t mipLevelCount)
     {
-        size_t textureImageIndex = createTextureImage(fileName);
+        const VkFormat format = cookedTextureVkFormat(cookedTexture.format);
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+        {
+            Log::add('V', 114);
+            return {};
+        }
+
+        const CookedMipLevel &baseLevel = cookedTexture.mipLevels[firstLevel];
 
-        if(textureImageIndex == INVALID_TEXTURE_INDEX)
-            return 0;
+        const uint32_t uploadedLevelCount = static_cast<uint32_t>(cookedTexture.mipLevels.size()) - firstLevel;
+        VkDeviceSize imageSize = cookedTexture.data.size() - baseLevel.offset;
 
-        VkImage sourceImage;
-        uint32_t mipLevelCount;
+        std::vector<VkBufferImageCopy> imageRegions;
+        imageRegions.reserve(uploadedLevelCount);
+        for (uint32_t mipIndex = 0; mipIndex < uploadedLevelCount; mipIndex++)
         {
-            std::lock_guard<std::mutex> lock(textureMutex);
-            sourceImage = textures.attachments[textureImageIndex].image;
-            mipLevelCount = textures.attachments[textureImageIndex].mipLevelCount;
+            const CookedMipLevel &mipLevel = cookedTexture.mipLevels[firstLevel + mipIndex];
+            imageRegions.push_back(imageCopyRegion(mipLevel.offset - baseLevel.offset, mipIndex, mipLevel.width, mipLevel.height));
         }
 
+        VkImage texImage;
+        MemoryAllocation texImageMemory;
+
+        // Every level was filtered and, for BC formats, block compressed by the cooker, so nothing is blitted here.
+        // A streamed chain is also the copy source of the one that replaces it
+        texImage = createImage(baseLevel.width, baseLevel.height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevelCount, 1, &texImageMemory);
+
+        uploadImage(batch, texImage, cookedTexture.data.data() + baseLevel.offset, imageSize, imageRegions);
+        releaseImage(batch, texImage, uploadedLevelCount < mipLevelCount ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, uploadedLevelCount);
+
+        return {texImage, texImageMemory, VK_NULL_HANDLE, mipLevelCount, format};
+    }
+
+    VkImageView Renderer::createTextureView(const ImageAttachment &attachment)
+    {
         VkImageViewCreateInfo imageViewCreateInfo{};
         imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        imageViewCreateInfo.image = sourceImage;
+        imageViewCreateInfo.image = attachment.image;
         imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageViewCreateInfo.format = attachment.format;
         imageViewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
         imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        imageViewCreateInfo.subresourceRange.levelCount = mipLevelCount;
+        imageViewCreateInfo.subresourceRange.levelCount = attachment.mipLevelCount;
         imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         imageViewCreateInfo.subresourceRange.layerCount = 1;
 
         VkImageView imageView;
         vkCheck(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView), {'V', 205});
 
+        return imageView;
+    }
+
+    uint32_t Renderer::createTexture(UploadBatch &batch, const std::string &fileName, bool allowStreaming)
+    {
+        uint32_t texIndex;
         {
             std::lock_guard<std::mutex> lock(textureMutex);
-            textures.attachments[textureImageIndex].imageView = imageView;
-            return createTextureDescriptor(imageView);
+
+            auto cached = textures.cache.find(fileName);
+            if (cached != textures.cache.end())
+            {
+                // Prefetched before another upload cached it
+                discardDecodedImage(fileName);
+
+                cached->second.refCount++;
+
+                if (!allowStreaming)
+                    textures.streams[cached->second.texIndex].isPinned = true;
+
+                // The batch uploading it may still be recording, so this one's buffers are published after it's submitted
+                if (cached->second.uploaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    batch.sharedTextureUploads.push_back(cached->second.uploaded);
+
+                return cached->second.texIndex;
+            }
+
+            texIndex = reserveTextureIndex();
+            if (texIndex == INVALID_TEXTURE_INDEX)
+            {
+                discardDecodedImage(fileName);
+                return INVALID_TEXTURE_INDEX;
+            }
+
+            std::promise<void> &upload = batch.textureUploads.emplace_back();
+            textures.cache[fileName] = {texIndex, 1, upload.get_future().share()};
+            textures.filePaths[texIndex] = fileName;
+        }
+
+        TextureStream stream;
+        ImageAttachment attachment = createTextureImage(batch, fileName, allowStreaming, stream);
+
+        // The index is already shared, so a file that failed to load keeps its slot and is drawn without a texture
+        if (!attachment.image)
+        {
+            std::lock_guard<std::mutex> lock(textureMutex);
+            textures.streams[texIndex].isMissing = true;
+            writeTextureDescriptor(texIndex, textures.attachments[INVALID_TEXTURE_INDEX].imageView);
+            return texIndex;
         }
+
+        attachment.imageView = createTextureView(attachment);
+
+        std::lock_guard<std::mutex> lock(textureMutex);
+        textures.attachments[texIndex] = attachment;
+        writeTextureDescriptor(texIndex, attachment.imageView);
+
+        // Field by field, a widget may have pinned it while it loaded
+        TextureStream &slotStream = textures.streams[texIndex];
+        slotStream.isStreamed = stream.isStreamed;
+        slotStream.size = stream.size;
+        slotStream.width = stream.width;
+        slotStream.height = stream.height;
+        slotStream.format = stream.format;
+        slotStream.mipTailBytes = std::move(stream.mipTailBytes);
+        slotStream.residentLevel = stream.residentLevel;
+
+        if (slotStream.isStreamed)
+            batch.acquires.streamedTextures.push_back({texIndex, slotStream.generation});
+
+        return texIndex;
     }
 
-    size_t Renderer::createTextureDescriptor(VkImageView textureImageView)
+    uint32_t Renderer::reserveTextureIndex()
     {
-        const auto createDescriptorPool = [&]()
+        if (!textures.freeIndices.empty())
         {
-            VkDescriptorPoolSize poolSize = {
-                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = TEXTURE_SAMPLER_POOL_CHUNK_SIZE};
+            const uint32_t texIndex = textures.freeIndices.back();
+            textures.freeIndices.pop_back();
 
-            VkDescriptorPoolCreateInfo poolCreateInfo = {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-                .maxSets = TEXTURE_SAMPLER_POOL_CHUNK_SIZE,
-                .poolSizeCount = 1,
-                .pPoolSizes = &poolSize};
+            textures.streams[texIndex] = {.generation = textures.streams[texIndex].generation + 1};
+            return texIndex;
+        }
 
-            VkDescriptorPool pool;
-            vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &pool);
-            return pool;
-        };
+        if (textures.attachments.size() == MAX_TEXTURE_COUNT)
+        {
+            Log::add('V', 113);
+            return INVALID_TEXTURE_INDEX;
+        }
 
-        if (textures.descriptorPools.empty())
-            textures.descriptorPools.emplace_back(createDescriptorPool());
+        textures.attachments.emplace_back();
+        textures.filePaths.emplace_back();
+        textures.streams.emplace_back();
 
-        VkDescriptorSet descriptorSet;
+        return static_cast<uint32_t>(textures.attachments.size() - 1);
+    }
 
-        VkDescriptorSetAllocateInfo setAllocInfo = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool = textures.descriptorPools.back(),
-            .descriptorSetCount = 1,
-            .pSetLayouts = &textures.descriptorSetLayout};
+    void Renderer::releaseTexture(uint32_t texIndex)
+    {
+        if (texIndex == INVALID_TEXTURE_INDEX)
+            return;
 
-        VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+        std::lock_guard<std::mutex> lock(textureMutex);
 
-        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
-        {
-            textures.descriptorPools.emplace_back(createDescriptorPool());
+        auto cached = textures.cache.find(textures.filePaths[texIndex]);
+        if (--cached->second.refCount > 0)
+            return;
 
-            setAllocInfo.descriptorPool = textures.descriptorPools.back();
-            vkCheck(vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet), {'V', 220});
-        }
-        else
+        textures.cache.erase(cached);
+        textures.streams[texIndex].isStreamed = false;
+
+        textures.retired.push_back({textures.attachments[texIndex], texIndex, frameIndex});
+        textures.attachments[texIndex] = {};
+    }
+
+    void Renderer::destroyRetiredTextures()
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+
+        // Called after waiting on this frame's fence, like destroyRetiredMeshBuffers
+        while (!textures.retired.empty() && textures.retired.front().frameIndex + FRAMES_IN_FLIGHT <= frameIndex)
         {
-            vkCheck(result, {'V', 220});
+            RetiredTexture &retired = textures.retired.front();
+
+            destroyImageAttachment(retired.attachment);
+
+            if (retired.freedIndex != INVALID_TEXTURE_INDEX)
+            {
+                textures.filePaths[retired.freedIndex].clear();
+                textures.freeIndices.push_back(retired.freedIndex);
+            }
+
+            textures.retired.pop_front();
         }
+    }
 
+    bool Renderer::areTextureUploadsSubmitted(const std::vector<std::shared_future<void>> &textureUploads)
+    {
+        return std::all_of(textureUploads.begin(), textureUploads.end(), [](const std::shared_future<void> &upload)
+                           { return upload.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+    }
+
+    uint32_t Renderer::textureDescriptorIndex(uint32_t texIndex) const
+    {
+        return textures.streams[texIndex].usesSecondDescriptor ? texIndex + MAX_TEXTURE_COUNT : texIndex;
+    }
+
+    void Renderer::writeTextureDescriptor(uint32_t descriptorIndex, VkImageView textureImageView)
+    {
         VkDescriptorImageInfo imageInfo = {
             .sampler = textures.sampler,
             .imageView = textureImageView,
@@ -505,18 +516,157 @@ namespace VE
 
         VkWriteDescriptorSet descriptorWrite = {
             .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptorSet,
+            .dstSet = textures.descriptorSet,
             .dstBinding = 0,
-            .dstArrayElement = 0,
+            .dstArrayElement = descriptorIndex,
             .descriptorCount = 1,
             .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
             .pImageInfo = &imageInfo};
 
         vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
 
-        textures.descriptorSets.push_back(descriptorSet);
+    void Renderer::startDecodeWorkers()
+    {
+        decodeWorkers.threads.reserve(DECODE_WORKER_COUNT);
+        for (uint32_t i = 0; i < DECODE_WORKER_COUNT; i++)
+            decodeWorkers.threads.emplace_back([this]
+                                               { runDecodeWorker(); });
+    }
+
+    void Renderer::runDecodeWorker()
+    {
+        while (true)
+        {
+            decodeWorkers.jobsAvailable.acquire();
+
+            if (decodeWorkers.isStopping.load(std::memory_order_acquire))
+                return;
+
+            // Same as the upload workers, the producer may still be finishing the push
+            DecodeJob job;
+            while (!decodeWorkers.jobs.tryPop(job))
+                std::this_thread::yield();
+
+            job();
+        }
+    }
+
+    void Renderer::stopDecodeWorkers()
+    {
+        decodeWorkers.isStopping.store(true, std::memory_order_release);
+        decodeWorkers.jobsAvailable.release(static_cast<std::ptrdiff_t>(decodeWorkers.threads.size()));
+
+        for (std::thread &thread : decodeWorkers.threads)
+            thread.join();
+        decodeWorkers.threads.clear();
+
+        decodeWorkers.pending.clear();
+    }
+
+    void Renderer::prefetchTextures(const std::vector<Mesh> &meshes)
+    {
+        for (const Mesh &mesh : meshes)
+        {
+            const std::string &fileName = mesh.getTextureFilePath();
+            if (fileName.empty())
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock(textureMutex);
+                if (textures.cache.contains(fileName))
+                    continue;
+            }
+
+            auto decoded = std::make_shared<std::promise<DecodedImage>>();
+            {
+                std::lock_guard<std::mutex> lock(decodeWorkers.pendingMutex);
+                if (decodeWorkers.pending.contains(fileName))
+                    continue;
+
+                decodeWorkers.pending[fileName] = decoded->get_future();
+            }
+
+            submitDecodeJob([decoded, fileName]
+                            { decoded->set_value(decodeImage(fileName)); });
+        }
+    }
+
+    // Kept out of the prefetch map, the file is already in the texture cache and createTexture discards those
+    std::shared_future<Renderer::DecodedImage> Renderer::decodeTextureLevels(const std::string &fileName, uint32_t firstLevel, uint32_t levelCount)
+    {
+        auto decoded = std::make_shared<std::promise<DecodedImage>>();
+        std::shared_future<DecodedImage> result = decoded->get_future().share();
+
+        submitDecodeJob([decoded, fileName, firstLevel, levelCount]
+                        {
+                            DecodedImage decodedImage;
+                            decodedImage.cookedTexture = std::make_shared<CookedTexture>(loadCookedTexture(fileName, firstLevel, levelCount));
+                            decoded->set_value(decodedImage); });
+
+        return result;
+    }
+
+    void Renderer::submitDecodeJob(DecodeJob &&job)
+    {
+        // Waited out like submitUploadJob, the workers free space as they decode
+        while (!decodeWorkers.jobs.tryPush(std::move(job)))
+            std::this_thread::yield();
+
+        decodeWorkers.jobsAvailable.release();
+    }
+
+    Renderer::DecodedImage Renderer::takeDecodedImage(const std::string &fileName)
+    {
+        std::future<DecodedImage> decoded;
+        {
+            std::lock_guard<std::mutex> lock(decodeWorkers.pendingMutex);
+
+            auto pending = decodeWorkers.pending.find(fileName);
+            if (pending != decodeWorkers.pending.end())
+            {
+                decoded = std::move(pending->second);
+                decodeWorkers.pending.erase(pending);
+            }
+        }
+
+        // Not prefetched, so this upload worker decodes it itself
+        if (!decoded.valid())
+            return decodeImage(fileName);
+
+        return decoded.get();
+    }
+
+    void Renderer::discardDecodedImage(const std::string &fileName)
+    {
+        std::lock_guard<std::mutex> lock(decodeWorkers.pendingMutex);
+        decodeWorkers.pending.erase(fileName);
+    }
+
+    Renderer::DecodedImage Renderer::decodeImage(const std::string &fileName)
+    {
+        DecodedImage decoded;
+
+        if (std::filesystem::path(fileName).extension() == COOKED_TEXTURE_EXTENSION)
+        {
+            decoded.cookedTexture = std::make_shared<CookedTexture>(loadCookedTexture(fileName));
+            return decoded;
+        }
+
+        // Refused by createTextureImage
+        if (COOKED_ASSETS_ONLY)
+            return decoded;
+
+        int width, height;
+        decoded.pixels = std::shared_ptr<uint8_t>(stbi_load(fileName.c_str(), &width, &height, nullptr, STBI_rgb_alpha), stbi_image_free);
+
+        if (decoded.pixels)
+        {
+            decoded.width = static_cast<uint32_t>(width);
+            decoded.height = static_cast<uint32_t>(height);
+        }
 
-        return textures.descriptorSets.size() - 1;
+        return decoded;
     }
 
     void Renderer::createTextureSampler()
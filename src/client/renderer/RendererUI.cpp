@@ -5,82 +5,113 @@
 
 #include "../../shared/Log.hpp"
 
+#include <algorithm>
+
 namespace VE
 {
 
     void Renderer::syncWidgetBuffers(const std::vector<Widget> &widgets)
     {
-        std::vector<const Widget *> widgetsToInit;
+        publishWidgetBuffers(widgets);
 
         for (const Widget &widget : widgets)
         {
-            bool widgetBufferFound = false;
-            for (WidgetBuffer &widgetBuffer : widgetBuffers)
+            if (queuedWidgetVersions.contains(widget.getHandle().getValue()))
+                continue;
+
+            if (const WidgetBuffer *widgetBuffer = findWidgetBuffer(widget.getHandle()))
             {
-                if (widget.getHandle() == widgetBuffer.handle)
+                if (widget.getVersion() > widgetBuffer->version)
                 {
-                    widgetBufferFound = true;
-                    if (widget.getVersion() > widgetBuffer.version)
-                    {
-                        Log::add('E', 100);
-                        // updateWidgetBuffer(widgetBuffer, widget);
-                    }
-                    break;
+                    Log::add('E', 100);
+                    // updateWidgetBuffer(widgetBuffer, widget);
                 }
             }
+            else
+            {
+                queuedWidgetVersions[widget.getHandle().getValue()] = widget.getVersion();
 
-            if (!widgetBufferFound)
-                widgetsToInit.push_back(&widget);
+                prefetchTextures(widget.getMeshes());
+
+                submitUploadJob([this, widget](UploadContext &context)
+                                {
+                                    WidgetBuffer newWidgetBuffer = createWidgetBuffer(context, widget);
+
+                                    std::lock_guard<std::mutex> lock(completedUploads.mutex);
+                                    completedUploads.widgets.push_back(std::move(newWidgetBuffer)); });
+            }
+        }
+    }
+
+    void Renderer::publishWidgetBuffers(const std::vector<Widget> &widgets)
+    {
+        std::vector<WidgetBuffer> completed;
+        {
+            std::lock_guard<std::mutex> lock(completedUploads.mutex);
+            completed.swap(completedUploads.widgets);
         }
 
-        if (widgetsToInit.size() == 1)
+        // Buffers reusing a texture whose upload isn't submitted yet wait for a later frame
+        auto pending = std::stable_partition(completed.begin(), completed.end(), [](const WidgetBuffer &widgetBuffer)
+                                             { return areTextureUploadsSubmitted(widgetBuffer.sharedTextureUploads); });
+        if (pending != completed.end())
         {
-            initWidgetBuffer(*widgetsToInit.front());
+            std::lock_guard<std::mutex> lock(completedUploads.mutex);
+            completedUploads.widgets.insert(completedUploads.widgets.end(), std::make_move_iterator(pending), std::make_move_iterator(completed.end()));
+            completed.erase(pending, completed.end());
         }
-        else if (widgetsToInit.size() > 1)
+
+        for (WidgetBuffer &newWidgetBuffer : completed)
         {
-            widgetMutex.unlock();
+            queuedWidgetVersions.erase(newWidgetBuffer.handle.getValue());
+
+            const bool isWidgetAlive = std::any_of(widgets.begin(), widgets.end(), [&](const Widget &widget)
+                                                   { return widget.getHandle() == newWidgetBuffer.handle; });
 
-            std::vector<std::thread> workers;
-            workers.reserve(widgetsToInit.size());
-            for (const Widget *widgetPtr : widgetsToInit)
+            // Its transfer may still be running, so the buffers wait out the frames like a removed widget's
+            if (!isWidgetAlive)
             {
-                workers.emplace_back([this, widgetPtr]
-                                     { initWidgetBuffer(*widgetPtr); });
+                retireMeshBuffers(std::move(newWidgetBuffer.meshBuffers));
+                continue;
             }
 
-            for (std::thread &w : workers)
-                w.join();
-
-            widgetMutex.lock();
+            widgetBufferIndices[newWidgetBuffer.handle.getValue()] = static_cast<uint32_t>(widgetBuffers.size());
+            widgetBuffers.push_back(std::move(newWidgetBuffer));
         }
     }
 
-    void Renderer::initWidgetBuffer(const Widget &widget)
+    Renderer::WidgetBuffer *Renderer::findWidgetBuffer(WidgetHandle handle)
+    {
+        auto it = widgetBufferIndices.find(handle.getValue());
+        return it == widgetBufferIndices.end() ? nullptr : &widgetBuffers[it->second];
+    }
+
+    Renderer::WidgetBuffer Renderer::createWidgetBuffer(UploadContext &context, const Widget &widget)
     {
         WidgetBuffer newWidgetBuffer(widget.getHandle());
 
         newWidgetBuffer.version = widget.getVersion();
 
+        UploadBatch uploadBatch;
+        beginUploadBatch(context, uploadBatch);
+
         for (const Mesh &mesh : widget.getMeshes())
         {
             MeshBuffer newMeshBuffer;
 
-            newMeshBuffer.vertexCount = mesh.getVertices().size();
-            newMeshBuffer.indexCount = mesh.getIndices().size();
-            createVertexBuffer(newMeshBuffer, mesh.getVertices());
-            createIndexBuffer(newMeshBuffer, mesh.getIndices());
+            createMeshGeometry(uploadBatch, newMeshBuffer, mesh, false);
 
             if (!mesh.getTextureFilePath().empty())
-                newMeshBuffer.texIndex = createTexture(mesh.getTextureFilePath());
+                newMeshBuffer.texIndex = createTexture(uploadBatch, mesh.getTextureFilePath(), false);
 
             newWidgetBuffer.meshBuffers.push_back(newMeshBuffer);
         }
 
-        {
-            std::lock_guard<std::recursive_mutex> lock(widgetMutex);
-            widgetBuffers.push_back(newWidgetBuffer);
-        }
+        endUploadBatch(uploadBatch);
+
+        newWidgetBuffer.sharedTextureUploads = std::move(uploadBatch.sharedTextureUploads);
+
+        return newWidgetBuffer;
     }
 
-}
\ No newline at end of file
+}
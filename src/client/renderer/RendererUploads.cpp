@@ -0,0 +1,510 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#include "Renderer.hpp"
+
+#include "../../shared/Log.hpp"
+
+#include <algorithm>
+
+namespace VE
+{
+    void Renderer::createStagingRing()
+    {
+        createBuffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.buffer, &staging.memory);
+
+        staging.data = static_cast<uint8_t *>(staging.memory.mappedData);
+    }
+
+    void Renderer::createUploadTimeline()
+    {
+        VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0};
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &semaphoreTypeCreateInfo};
+
+        vkCheck(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &uploadTimeline.semaphore), {'V', 215});
+    }
+
+    void Renderer::waitForUploadTimeline(uint64_t timelineValue)
+    {
+        if (timelineValue == 0)
+            return;
+
+        VkSemaphoreWaitInfo waitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &uploadTimeline.semaphore,
+            .pValues = &timelineValue};
+
+        vkCheck(vkWaitSemaphores(device, &waitInfo, UINT64_MAX), {'V', 243});
+    }
+
+    Renderer::UploadContext Renderer::createUploadContext()
+    {
+        UploadContext context;
+
+        VkCommandPoolCreateInfo poolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = transferQueueFamilyIndex};
+
+        for (UploadCommandSlot &slot : context.slots)
+        {
+            vkCheck(vkCreateCommandPool(device, &poolCreateInfo, nullptr, &slot.commandPool), {'V', 208});
+
+            VkCommandBufferAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = slot.commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1};
+            vkCheck(vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer), {'V', 212});
+        }
+
+        return context;
+    }
+
+    void Renderer::destroyUploadContext(UploadContext &context)
+    {
+        for (UploadCommandSlot &slot : context.slots)
+        {
+            waitForUploadTimeline(slot.timelineValue);
+
+            if (slot.commandPool)
+                vkDestroyCommandPool(device, slot.commandPool, nullptr);
+        }
+
+        context = {};
+    }
+
+    void Renderer::startUploadWorkers()
+    {
+        uploadWorkers.contexts.reserve(UPLOAD_WORKER_COUNT);
+        for (uint32_t i = 0; i < UPLOAD_WORKER_COUNT; i++)
+            uploadWorkers.contexts.push_back(createUploadContext());
+
+        uploadWorkers.threads.reserve(UPLOAD_WORKER_COUNT);
+        for (UploadContext &context : uploadWorkers.contexts)
+        {
+            uploadWorkers.threads.emplace_back([this, &context]
+                                               { runUploadWorker(context); });
+        }
+    }
+
+    void Renderer::runUploadWorker(UploadContext &context)
+    {
+        while (true)
+        {
+            uploadWorkers.jobsAvailable.acquire();
+
+            if (uploadWorkers.isStopping.load(std::memory_order_acquire))
+                return;
+
+            // A permit means a job is queued, but its producer may still be finishing the push
+            UploadJob job;
+            while (!uploadWorkers.jobs.tryPop(job))
+                std::this_thread::yield();
+
+            job(context);
+        }
+    }
+
+    void Renderer::submitUploadJob(UploadJob job)
+    {
+        // Only full when thousands of assets are requested at once, so waiting it out is fine
+        while (!uploadWorkers.jobs.tryPush(std::move(job)))
+            std::this_thread::yield();
+
+        uploadWorkers.jobsAvailable.release();
+    }
+
+    void Renderer::stopUploadWorkers()
+    {
+        uploadWorkers.isStopping.store(true, std::memory_order_release);
+        uploadWorkers.jobsAvailable.release(static_cast<std::ptrdiff_t>(uploadWorkers.threads.size()));
+
+        for (std::thread &thread : uploadWorkers.threads)
+            thread.join();
+        uploadWorkers.threads.clear();
+
+        for (UploadContext &context : uploadWorkers.contexts)
+            destroyUploadContext(context);
+        uploadWorkers.contexts.clear();
+    }
+
+    void Renderer::beginUploadBatch(UploadContext &context, UploadBatch &batch)
+    {
+        // Everything one job uploads goes through a single batch, a nested one is a bug rather than a hang
+        if (context.hasOpenBatch)
+            Log::add('V', 228);
+        context.hasOpenBatch = true;
+
+        batch.context = &context;
+
+        beginUploadCommands(batch);
+    }
+
+    void Renderer::beginUploadCommands(UploadBatch &batch)
+    {
+        UploadCommandSlot &slot = batch.context->slots[batch.context->currentSlot];
+
+        // Only blocks when both slots of this worker are still on the transfer queue
+        waitForUploadTimeline(slot.timelineValue);
+
+        vkCheck(vkResetCommandPool(device, slot.commandPool, 0), {'V', 213});
+
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+        vkCheck(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo), {'V', 213});
+
+        batch.commandBuffer = slot.commandBuffer;
+    }
+
+    void Renderer::submitUploadBatch(UploadBatch &batch)
+    {
+        vkCheck(vkEndCommandBuffer(batch.commandBuffer), {'V', 213});
+
+        uint64_t timelineValue;
+        {
+            std::lock_guard<std::mutex> lock(transferQueueMutex);
+
+            // Values are handed out and submitted under one lock so the queue signals them in order
+            timelineValue = ++uploadTimeline.submittedValue;
+
+            VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &timelineValue};
+
+            VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineSubmitInfo,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &batch.commandBuffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &uploadTimeline.semaphore};
+
+            vkCheck(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE), {'V', 224});
+        }
+
+        UploadContext &context = *batch.context;
+        context.slots[context.currentSlot].timelineValue = timelineValue;
+        context.currentSlot = (context.currentSlot + 1) % UPLOAD_COMMAND_SLOT_COUNT;
+
+        {
+            std::lock_guard<std::mutex> lock(staging.mutex);
+
+            for (StagingRegion *region : batch.stagingRegions)
+                region->timelineValue = timelineValue;
+
+            for (DedicatedStagingBuffer &dedicatedBuffer : batch.dedicatedBuffers)
+            {
+                dedicatedBuffer.timelineValue = timelineValue;
+                staging.dedicatedBuffers.push_back(dedicatedBuffer);
+            }
+        }
+        staging.regionSubmitted.notify_all();
+
+        {
+            std::lock_guard<std::mutex> lock(uploadTimeline.mutex);
+
+            UploadAcquires &pending = uploadTimeline.pendingAcquires;
+            pending.bufferBarriers.insert(pending.bufferBarriers.end(), batch.acquires.bufferBarriers.begin(), batch.acquires.bufferBarriers.end());
+            pending.imageBarriers.insert(pending.imageBarriers.end(), batch.acquires.imageBarriers.begin(), batch.acquires.imageBarriers.end());
+            pending.mipmapGenerations.insert(pending.mipmapGenerations.end(), batch.acquires.mipmapGenerations.begin(), batch.acquires.mipmapGenerations.end());
+            pending.mipTailCopies.insert(pending.mipTailCopies.end(), batch.acquires.mipTailCopies.begin(), batch.acquires.mipTailCopies.end());
+            pending.streamedTextures.insert(pending.streamedTextures.end(), batch.acquires.streamedTextures.begin(), batch.acquires.streamedTextures.end());
+
+            uploadTimeline.pendingValue = std::max(uploadTimeline.pendingValue, timelineValue);
+        }
+
+        batch.stagingRegions.clear();
+        batch.dedicatedBuffers.clear();
+        batch.acquires = {};
+
+        batch.hasCommands = false;
+    }
+
+    void Renderer::flushUploadBatch(UploadBatch &batch)
+    {
+        if (!batch.hasCommands)
+            return;
+
+        submitUploadBatch(batch);
+        beginUploadCommands(batch);
+    }
+
+    void Renderer::endUploadBatch(UploadBatch &batch)
+    {
+        // An empty batch leaves its command buffer recording, the next begin resets the pool
+        if (batch.hasCommands)
+            submitUploadBatch(batch);
+
+        for (std::promise<void> &textureUpload : batch.textureUploads)
+            textureUpload.set_value();
+        batch.textureUploads.clear();
+
+        batch.context->hasOpenBatch = false;
+        batch.context = nullptr;
+        batch.commandBuffer = VK_NULL_HANDLE;
+    }
+
+    void Renderer::retireStaging()
+    {
+        uint64_t completedValue;
+        vkCheck(vkGetSemaphoreCounterValue(device, uploadTimeline.semaphore, &completedValue), {'V', 243});
+
+        while (!staging.regions.empty() && staging.regions.front().timelineValue != 0 && staging.regions.front().timelineValue <= completedValue)
+            staging.regions.pop_front();
+
+        std::erase_if(staging.dedicatedBuffers, [&](DedicatedStagingBuffer &dedicatedBuffer)
+                      {
+                          if (dedicatedBuffer.timelineValue > completedValue)
+                              return false;
+
+                          vkDestroyBuffer(device, dedicatedBuffer.buffer, nullptr);
+                          memoryAllocator.free(dedicatedBuffer.memory);
+                          return true; });
+    }
+
+    Renderer::StagingAllocation Renderer::allocateStaging(UploadBatch &batch, VkDeviceSize size)
+    {
+        if (size > STAGING_RING_SIZE)
+        {
+            DedicatedStagingBuffer dedicatedBuffer;
+            createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &dedicatedBuffer.buffer, &dedicatedBuffer.memory);
+
+            batch.dedicatedBuffers.push_back(dedicatedBuffer);
+
+            return {dedicatedBuffer.buffer, 0, dedicatedBuffer.memory.mappedData};
+        }
+
+        std::unique_lock<std::mutex> lock(staging.mutex);
+
+        while (true)
+        {
+            retireStaging();
+
+            const VkDeviceSize alignedHead = (staging.head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+            bool hasSpace = false;
+            VkDeviceSize offset = 0;
+
+            if (staging.regions.empty())
+            {
+                hasSpace = true;
+            }
+            else
+            {
+                const VkDeviceSize tail = staging.regions.front().begin;
+
+                if (tail < staging.head)
+                {
+                    if (alignedHead + size <= STAGING_RING_SIZE)
+                    {
+                        hasSpace = true;
+                        offset = alignedHead;
+                    }
+                    else if (size <= tail)
+                    {
+                        hasSpace = true;
+                    }
+                }
+                else if (alignedHead + size <= tail)
+                {
+                    hasSpace = true;
+                    offset = alignedHead;
+                }
+            }
+
+            if (hasSpace)
+            {
+                staging.head = offset + size;
+                staging.regions.push_back({offset, offset + size});
+                batch.stagingRegions.push_back(&staging.regions.back());
+
+                return {staging.buffer, offset, staging.data + offset};
+            }
+
+            // Our own pending copies may be what is holding the ring
+            if (!batch.stagingRegions.empty())
+            {
+                lock.unlock();
+                flushUploadBatch(batch);
+                lock.lock();
+            }
+            else if (staging.regions.front().timelineValue != 0)
+            {
+                const uint64_t timelineValue = staging.regions.front().timelineValue;
+
+                lock.unlock();
+                waitForUploadTimeline(timelineValue);
+                lock.lock();
+            }
+            else
+            {
+                staging.regionSubmitted.wait(lock);
+            }
+        }
+    }
+
+    void Renderer::uploadBuffer(UploadBatch &batch, VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size)
+    {
+        StagingAllocation allocation = allocateStaging(batch, size);
+
+        memcpy(allocation.data, data, static_cast<size_t>(size));
+
+        VkBufferCopy bufferCopyRegion = {
+            .srcOffset = allocation.offset,
+            .dstOffset = dstOffset,
+            .size = size};
+
+        vkCmdCopyBuffer(batch.commandBuffer, allocation.buffer, dstBuffer, 1, &bufferCopyRegion);
+
+        // Buffer uploads are only ever read as geometry, so the range is handed over right away
+        VkBufferMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = dstBuffer,
+            .offset = dstOffset,
+            .size = size};
+
+        if (transferQueueFamilyIndex != graphicsQueueFamilyIndex)
+        {
+            barrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        }
+
+        batch.acquires.bufferBarriers.push_back(barrier);
+
+        batch.hasCommands = true;
+    }
+
+    void Renderer::uploadImage(UploadBatch &batch, VkImage dstImage, const void *data, VkDeviceSize size, std::vector<VkBufferImageCopy> imageRegions)
+    {
+        StagingAllocation allocation = allocateStaging(batch, size);
+
+        memcpy(allocation.data, data, static_cast<size_t>(size));
+
+        uint32_t mipLevelCount = 0;
+        for (VkBufferImageCopy &imageRegion : imageRegions)
+        {
+            imageRegion.bufferOffset += allocation.offset;
+            mipLevelCount = std::max(mipLevelCount, imageRegion.imageSubresource.mipLevel + 1);
+        }
+
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = dstImage,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevelCount, 0, 1}};
+
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdCopyBufferToImage(batch.commandBuffer, allocation.buffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+
+        batch.hasCommands = true;
+    }
+
+    void Renderer::releaseImage(UploadBatch &batch, VkImage image, VkImageLayout layout, uint32_t mipLevelCount)
+    {
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevelCount, 0, 1}};
+
+        // The layout change is carried by both halves of the transfer and happens once
+        if (transferQueueFamilyIndex != graphicsQueueFamilyIndex)
+        {
+            barrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        batch.acquires.imageBarriers.push_back(barrier);
+    }
+
+    uint64_t Renderer::recordUploadAcquires(VkCommandBuffer commandBuffer)
+    {
+        UploadAcquires acquires;
+        uint64_t timelineValue;
+        {
+            std::lock_guard<std::mutex> lock(uploadTimeline.mutex);
+
+            if (uploadTimeline.pendingValue == 0)
+                return 0;
+
+            acquires = std::move(uploadTimeline.pendingAcquires);
+            uploadTimeline.pendingAcquires = {};
+
+            timelineValue = uploadTimeline.pendingValue;
+            uploadTimeline.pendingValue = 0;
+        }
+
+        // The frame waits on the timeline at the transfer stage, which these barriers chain onto
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(acquires.bufferBarriers.size()), acquires.bufferBarriers.data(),
+                             static_cast<uint32_t>(acquires.imageBarriers.size()), acquires.imageBarriers.data());
+
+        for (const MipmapGeneration &mipmapGeneration : acquires.mipmapGenerations)
+            recordMipmapGeneration(commandBuffer, mipmapGeneration);
+
+        if (!acquires.mipTailCopies.empty() || !acquires.streamedTextures.empty())
+        {
+            std::lock_guard<std::mutex> lock(textureMutex);
+
+            // A released texture's old chain is retired and may be gone, its new one is never drawn either
+            for (const MipTailCopy &tailCopy : acquires.mipTailCopies)
+            {
+                const TextureStream &stream = textures.streams[tailCopy.texIndex];
+                if (stream.generation == tailCopy.generation && stream.isStreamed)
+                    recordMipTailCopy(commandBuffer, tailCopy);
+            }
+
+            for (const StreamedTextureAcquire &streamedTexture : acquires.streamedTextures)
+            {
+                TextureStream &stream = textures.streams[streamedTexture.texIndex];
+                if (stream.generation == streamedTexture.generation)
+                    stream.streamableFrameIndex = frameIndex + 1;
+            }
+        }
+
+        return timelineValue;
+    }
+
+    void Renderer::destroyStagingRing()
+    {
+        for (DedicatedStagingBuffer &dedicatedBuffer : staging.dedicatedBuffers)
+        {
+            vkDestroyBuffer(device, dedicatedBuffer.buffer, nullptr);
+            memoryAllocator.free(dedicatedBuffer.memory);
+        }
+        staging.dedicatedBuffers.clear();
+
+        if (staging.buffer)
+            vkDestroyBuffer(device, staging.buffer, nullptr);
+        memoryAllocator.free(staging.memory);
+    }
+}
@@ -1,65 +1,147 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec2 fragTex;
-layout(location = 1) flat in uint fragTextureIndex;
+layout(location = 1) flat in uint fragDrawIndex;
 layout(location = 2) in vec3 fragWorldPos;
 layout(location = 3) in vec3 fragNormal;
 layout(location = 4) flat in float fragLightStrength;
-layout(location = 5) in vec4 fragPosLightSpace;
+layout(location = 5) in float fragViewDepth;
+layout(location = 6) flat in vec3 fragLightColor;
 
 layout(set = 0, binding = 1) uniform UboLighting {
-    vec4 lightPos;
-    vec4 lightColor;
+    vec4 sunDirection;
+    vec4 sunColor;
     vec4 viewPos;
+    mat4 cascadeMats[4];
+    vec4 cascadeSplits;
+    vec4 clusterParams;
     float outdoorBrightness;
+    uint pointLightCount;
 } uboLighting;
 
-layout(push_constant) uniform PushMaterial {
-    layout(offset = 80) vec4 baseColor;
+// Matches the light cluster grid in Renderer.hpp
+const uvec3 CLUSTER_COUNT = uvec3(16, 9, 24);
+
+struct PointLight {
+    vec4 positionRadius;
+    vec4 colorStrength;
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightBuffer {
+    PointLight pointLights[];
+};
+
+// First light index and light count of every cluster
+layout(std430, set = 0, binding = 4) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
+struct DrawData {
+    mat4 dequantizeMat;
+    vec4 baseColor;
     float metallic;
     float roughness;
-} pushMaterial;
+    uint textureIndex;
+    uint countIndex;
+    uint runFirstDraw;
+    uint visibleOffset;
+    vec4 boundingSphere;
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
-layout(set = 0, binding = 2) uniform sampler2DShadow shadowMap;
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+layout(set = 0, binding = 2) uniform sampler2DArrayShadow shadowMap;
 
 layout(location = 0) out vec4 outColor;
 
-float calcShadow(vec4 posLightSpace) {
+// The first cascade whose split lies beyond the fragment covers it, past the last one nothing is shadowed
+float calcShadow(vec3 worldPos, float viewDepth) {
+    int cascade = 0;
+    while (cascade < 4 && viewDepth > uboLighting.cascadeSplits[cascade]) cascade++;
+    if (cascade == 4) return 0.0;
+
+    vec4 posLightSpace = uboLighting.cascadeMats[cascade] * vec4(worldPos, 1.0);
     vec3 shadowMapCoords = posLightSpace.xyz / posLightSpace.w;
     shadowMapCoords.xy = shadowMapCoords.xy * 0.5 + 0.5;
     if (shadowMapCoords.z > 1.0 || shadowMapCoords.z < 0.0) return 0.0;
     float currentDepth = shadowMapCoords.z;
-    float lightFactor = texture(shadowMap, vec3(shadowMapCoords.xy, currentDepth));
+    float lightFactor = texture(shadowMap, vec4(shadowMapCoords.xy, cascade, currentDepth));
     return 1.0 - lightFactor;
 }
 
+// Only the lights binned into this fragment's cluster are evaluated
+vec3 calcPointLights(vec3 baseRgb, vec3 normalDir, vec3 viewDirection) {
+    float slice = log(fragViewDepth) * uboLighting.clusterParams.x + uboLighting.clusterParams.y;
+    if (slice >= float(CLUSTER_COUNT.z)) return vec3(0.0);
+
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / uboLighting.clusterParams.zw * vec2(CLUSTER_COUNT.xy)), CLUSTER_COUNT.xy - 1u);
+    uvec2 cluster = clusters[tile.x + CLUSTER_COUNT.x * (tile.y + CLUSTER_COUNT.y * uint(max(slice, 0.0)))];
+
+    vec3 color = vec3(0.0);
+    for (uint i = 0; i < cluster.y; i++) {
+        PointLight light = pointLights[lightIndices[cluster.x + i]];
+
+        vec3 toLight = light.positionRadius.xyz - fragWorldPos;
+        float distanceSquared = dot(toLight, toLight);
+
+        // Inverse square falloff, windowed to reach zero at the light's range
+        float rangeRatio = distanceSquared / (light.positionRadius.w * light.positionRadius.w);
+        float window = clamp(1.0 - rangeRatio * rangeRatio, 0.0, 1.0);
+        float attenuation = light.colorStrength.w * window * window / (1.0 + distanceSquared);
+        if (attenuation <= 0.0) continue;
+
+        vec3 lightDir = toLight * inversesqrt(distanceSquared);
+        vec3 halfVector = normalize(lightDir + viewDirection);
+
+        float diff = max(dot(normalDir, lightDir), 0.0);
+        float spec = pow(max(dot(normalDir, halfVector), 0.0), 32.0);
+
+        color += (baseRgb * diff * 0.5 + spec * 0.3) * light.colorStrength.rgb * attenuation;
+    }
+    return color;
+}
+
 void main(){
-    vec4 base = (fragTextureIndex == 0) ? pushMaterial.baseColor : texture(textureSampler, fragTex);
+    DrawData draw = draws[fragDrawIndex];
+
+    vec4 base = (draw.textureIndex == 0) ? draw.baseColor : texture(textures[nonuniformEXT(draw.textureIndex)], fragTex);
 
     if (fragLightStrength > 0.0) {
-        outColor = uboLighting.lightColor;
+        outColor = vec4(fragLightColor, 1.0);
         return;
     }
 
-    if (uboLighting.lightPos.w == 0) {
+    if (uboLighting.sunDirection.w == 0 && uboLighting.pointLightCount == 0) {
         outColor = base;
         return;
     }
 
     vec3 normalDir = normalize(fragNormal);
-    vec3 lightDir = normalize(uboLighting.lightPos.xyz - fragWorldPos);
     vec3 viewDirection = normalize(uboLighting.viewPos.xyz  - fragWorldPos);
-    vec3 halfVector = normalize(lightDir + viewDirection);
-
-    float diff = max(dot(normalDir, lightDir), 0.0);
-    float spec = pow(max(dot(normalDir, halfVector), 0.0), 32.0);
-
-    float intensity = uboLighting.lightPos.w;
     vec3 baseRgb = base.rgb;
     vec3 ambient = baseRgb * mix(0.02, 0.3, uboLighting.outdoorBrightness);
-    vec3 diffuse = baseRgb * uboLighting.lightColor.rgb * diff * intensity * 0.5;
-    vec3 specular = uboLighting.lightColor.rgb * spec * intensity * 0.3;
-    vec3 color = ambient + (diffuse + specular) * (1.0 - calcShadow(fragPosLightSpace));
+    vec3 color = ambient + calcPointLights(baseRgb, normalDir, viewDirection);
+
+    if (uboLighting.sunDirection.w > 0) {
+        vec3 lightDir = uboLighting.sunDirection.xyz;
+        vec3 halfVector = normalize(lightDir + viewDirection);
+
+        float diff = max(dot(normalDir, lightDir), 0.0);
+        float spec = pow(max(dot(normalDir, halfVector), 0.0), 32.0);
+
+        float intensity = uboLighting.sunDirection.w;
+        vec3 diffuse = baseRgb * uboLighting.sunColor.rgb * diff * intensity * 0.5;
+        vec3 specular = uboLighting.sunColor.rgb * spec * intensity * 0.3;
+        color += (diffuse + specular) * (1.0 - calcShadow(fragWorldPos, fragViewDepth));
+    }
+
     outColor = vec4(color, base.a);
 }
\ No newline at end of file
@@ -1,36 +1,97 @@
-#version 450
+#version 460
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec2 tex;
 layout(location = 2) in vec3 normal;
 
+// Packed vertices carry an octahedral normal in normal.xy
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
+
+// Opaque draws go through the culling pass, transparent ones are culled and sorted on the CPU
+layout(constant_id = 1) const bool CULLED_DRAWS = false;
+
 layout(set = 0, binding = 0) uniform UboCamera {
     mat4 projection;
     mat4 view;
-    mat4 lightSpaceMat;
 } uboCamera;
 
-layout(push_constant) uniform PushVertex {
+struct InstanceData {
     mat4 model;
-    uint textureIndex;
+    vec3 lightColor;
     float lightStrength;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+struct DrawData {
+    mat4 dequantizeMat;
+    vec4 baseColor;
+    float metallic;
+    float roughness;
+    uint textureIndex;
+    uint countIndex;
+    uint runFirstDraw;
+    uint visibleOffset;
+    vec4 boundingSphere;
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+// Written by cull.comp, the compacted draws of a run and the instances each of them kept
+layout(std430, set = 2, binding = 4) readonly buffer CulledDrawIndexBuffer {
+    uint culledDrawIndices[];
+};
+
+layout(std430, set = 2, binding = 5) readonly buffer VisibleInstanceBuffer {
+    uint visibleInstances[];
+};
+
+// gl_DrawID counts from 0 in every indirect call
+layout(push_constant) uniform PushVertex {
+    uint firstDraw;
 }pushVertex;
 
 layout(location = 0) out vec2 fragTex;
-layout(location = 1) flat out uint fragTextureIndex;
+layout(location = 1) flat out uint fragDrawIndex;
 layout(location = 2) out vec3 fragWorldPos;
 layout(location = 3) out vec3 fragNormal;
 layout(location = 4) flat out float fragLightStrength;
-layout(location = 5) out vec4 fragPosLightSpace;
+layout(location = 5) out float fragViewDepth;
+layout(location = 6) flat out vec3 fragLightColor;
+
+vec3 decodeOctahedral(vec2 encoded){
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main(){
-    vec4 worldPos = pushVertex.model * vec4(pos, 1.0);
-    gl_Position = uboCamera.projection * uboCamera.view * worldPos;
+    vec3 vertexNormal = PACKED_VERTEX ? decodeOctahedral(normal.xy) : normal;
+
+    uint drawIndex = pushVertex.firstDraw + gl_DrawID;
+    uint instanceIndex = gl_InstanceIndex;
+    if (CULLED_DRAWS) {
+        drawIndex = culledDrawIndices[drawIndex];
+        instanceIndex = visibleInstances[instanceIndex];
+    }
+
+    mat4 model = instances[instanceIndex].model * draws[drawIndex].dequantizeMat;
+
+    vec4 worldPos = model * vec4(pos, 1.0);
+    vec4 viewPos = uboCamera.view * worldPos;
+    gl_Position = uboCamera.projection * viewPos;
 
     fragTex = tex;
-    fragTextureIndex = pushVertex.textureIndex;
+    fragDrawIndex = drawIndex;
     fragWorldPos = worldPos.xyz;
-    fragNormal = mat3(pushVertex.model) * normal;
-    fragLightStrength = pushVertex.lightStrength;
-    fragPosLightSpace = uboCamera.lightSpaceMat * pushVertex.model * vec4(pos, 1.0);
+    fragNormal = mat3(model) * vertexNormal;
+    fragLightStrength = instances[instanceIndex].lightStrength;
+    fragLightColor = instances[instanceIndex].lightColor;
+    fragViewDepth = -viewPos.z;
 }
\ No newline at end of file
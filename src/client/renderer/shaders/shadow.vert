@@ -1,12 +1,50 @@
-#version 450
+#version 460
 layout(location = 0) in vec3 pos;
 
-layout(push_constant) uniform ShadowPushData {
+struct InstanceData {
     mat4 model;
+    vec3 lightColor;
+    float lightStrength;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+struct DrawData {
+    mat4 dequantizeMat;
+    vec4 baseColor;
+    float metallic;
+    float roughness;
+    uint textureIndex;
+    uint countIndex;
+    uint runFirstDraw;
+    uint visibleOffset;
+    vec4 boundingSphere;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+// Written by cull.comp, the compacted draws of a run and the instances each of them kept
+layout(std430, set = 0, binding = 4) readonly buffer CulledDrawIndexBuffer {
+    uint culledDrawIndices[];
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer VisibleInstanceBuffer {
+    uint visibleInstances[];
+};
+
+layout(push_constant) uniform ShadowPushData {
     mat4 lightSpaceMat;
+    uint firstDraw;
 } shadowPushData;
 
 void main()
 {
-    gl_Position = shadowPushData.lightSpaceMat * shadowPushData.model * vec4(pos, 1.0);
+    uint drawIndex = culledDrawIndices[shadowPushData.firstDraw + gl_DrawID];
+    uint instanceIndex = visibleInstances[gl_InstanceIndex];
+
+    gl_Position = shadowPushData.lightSpaceMat * instances[instanceIndex].model * draws[drawIndex].dequantizeMat * vec4(pos, 1.0);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec4 inCol;
 layout(location = 1) in vec2 fragTex;
@@ -6,9 +7,9 @@ layout(location = 2) flat in uint fragTextureIndex;
 
 layout(location = 0) out vec4 outCol;
 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 void main()
 {
-    outCol = (fragTextureIndex == 0) ? inCol : texture(textureSampler, fragTex);
+    outCol = (fragTextureIndex == 0) ? inCol : texture(textures[nonuniformEXT(fragTextureIndex)], fragTex);
 }
\ No newline at end of file
@@ -0,0 +1,415 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "../shared/MeshLoader.hpp"
+#include "../shared/MeshOptimizer.hpp"
+#include "../shared/AssetFormat.hpp"
+#include "TextureCompression.hpp"
+
+#include "../../ext/stb_image/stb_image.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <exception>
+
+using namespace VE;
+
+static constexpr char COOK_USAGE[] = "Usage: verge_cook <input directory> <output directory> [--threads N] [--texture-format auto|rgba8|bc7]\n";
+
+enum CookJobType
+{
+    COOK_JOB_TYPE_MODEL,
+    COOK_JOB_TYPE_TEXTURE
+};
+
+// Automatic picks BC1 for opaque textures and BC3 for ones with alpha
+enum TextureFormatOption
+{
+    TEXTURE_FORMAT_OPTION_AUTO,
+    TEXTURE_FORMAT_OPTION_RGBA8,
+    TEXTURE_FORMAT_OPTION_BC7
+};
+
+struct CookJob
+{
+    CookJobType type;
+    std::filesystem::path inputPath;
+    std::filesystem::path outputPath;
+};
+
+struct CookResult
+{
+    bool success = false;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    std::string details;
+};
+
+static std::string toLower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                   { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+static std::string formatBytes(uint64_t bytes)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+
+    if (bytes >= 1024 * 1024)
+        out << bytes / (1024.0 * 1024.0) << " MB";
+    else if (bytes >= 1024)
+        out << bytes / 1024.0 << " KB";
+    else
+        out << bytes << " B";
+
+    return out.str();
+}
+
+// Box filters every level from the previous one, the same chain the runtime blits produced
+static CookedTexture buildMipChain(const uint8_t *pixels, uint32_t width, uint32_t height)
+{
+    CookedTexture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.format = COOKED_TEXTURE_FORMAT_RGBA8;
+
+    texture.data.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    texture.mipLevels.push_back({width, height, 0, texture.data.size()});
+
+    while (width > 1 || height > 1)
+    {
+        const CookedMipLevel source = texture.mipLevels.back();
+
+        uint32_t nextWidth = std::max(width / 2, 1u);
+        uint32_t nextHeight = std::max(height / 2, 1u);
+
+        CookedMipLevel mipLevel = {nextWidth, nextHeight, texture.data.size(), static_cast<uint64_t>(nextWidth) * nextHeight * 4};
+        texture.data.resize(mipLevel.offset + mipLevel.size);
+
+        const uint8_t *src = texture.data.data() + source.offset;
+        uint8_t *dst = texture.data.data() + mipLevel.offset;
+
+        for (uint32_t y = 0; y < nextHeight; y++)
+        {
+            uint32_t y0 = std::min(y * 2, height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+            for (uint32_t x = 0; x < nextWidth; x++)
+            {
+                uint32_t x0 = std::min(x * 2, width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    uint32_t sum = src[(y0 * width + x0) * 4 + channel] +
+                                   src[(y0 * width + x1) * 4 + channel] +
+                                   src[(y1 * width + x0) * 4 + channel] +
+                                   src[(y1 * width + x1) * 4 + channel];
+
+                    dst[(y * nextWidth + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+
+        texture.mipLevels.push_back(mipLevel);
+
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    return texture;
+}
+
+static CookResult cookModel(const CookJob &job)
+{
+    CookResult result;
+
+    ModelData data = loadOBJ(job.inputPath.string());
+    if (data.meshes.empty())
+    {
+        result.details = "failed to parse OBJ";
+        return result;
+    }
+
+    const std::filesystem::path inputDirectory = job.inputPath.parent_path();
+
+    uint64_t sourceVertexCount = 0;
+    uint64_t cookedVertexCount = 0;
+    uint64_t triangleCount = 0;
+    double sourceMissCount = 0.0;
+    double cookedMissCount = 0.0;
+    std::ostringstream meshReport;
+    meshReport << std::fixed << std::setprecision(3);
+
+    ModelData cookedData;
+    cookedData.materials = data.materials;
+    cookedData.meshes.reserve(data.meshes.size());
+
+    for (const Mesh &mesh : data.meshes)
+    {
+        Mesh optimized = optimizeMesh(mesh);
+
+        const uint64_t meshTriangleCount = mesh.getIndices().size() / 3;
+        const double sourceACMR = computeACMR(mesh.getIndices(), mesh.getVertices().size());
+        const double cookedACMR = computeACMR(optimized.getIndices(), optimized.getVertices().size());
+
+        sourceVertexCount += mesh.getVertices().size();
+        cookedVertexCount += optimized.getVertices().size();
+        triangleCount += meshTriangleCount;
+        sourceMissCount += sourceACMR * meshTriangleCount;
+        cookedMissCount += cookedACMR * meshTriangleCount;
+
+        meshReport << "\n       mesh " << cookedData.meshes.size() << ": " << meshTriangleCount << " triangles, ACMR " << sourceACMR << " -> " << cookedACMR;
+
+        // Point the mesh at the cooked texture, relative to the model
+        std::string texturePath = Mesh::NO_TEXTURE;
+        if (!optimized.getTextureFilePath().empty())
+            texturePath = std::filesystem::path(optimized.getTextureFilePath()).lexically_relative(inputDirectory).replace_extension(COOKED_TEXTURE_EXTENSION).generic_string();
+
+        cookedData.meshes.emplace_back(optimized.getVertices(), optimized.getIndices(), optimized.getMaterialIndex(), texturePath);
+    }
+
+    if (!saveCookedModel(job.outputPath.string(), cookedData))
+    {
+        result.details = "failed to write output";
+        return result;
+    }
+
+    result.success = true;
+    std::ostringstream details;
+    details << cookedData.meshes.size() << " meshes, " << sourceVertexCount << " -> " << cookedVertexCount << " vertices, ACMR "
+            << std::fixed << std::setprecision(3) << sourceMissCount / std::max<uint64_t>(triangleCount, 1) << " -> " << cookedMissCount / std::max<uint64_t>(triangleCount, 1)
+            << meshReport.str();
+
+    result.details = details.str();
+
+    return result;
+}
+
+static const char *textureFormatName(CookedTextureFormat format)
+{
+    switch (format)
+    {
+    case COOKED_TEXTURE_FORMAT_BC1:
+        return "BC1";
+    case COOKED_TEXTURE_FORMAT_BC3:
+        return "BC3";
+    case COOKED_TEXTURE_FORMAT_BC7:
+        return "BC7";
+    default:
+        return "RGBA8";
+    }
+}
+
+static CookResult cookTexture(const CookJob &job, TextureFormatOption formatOption)
+{
+    CookResult result;
+
+    int width, height;
+    stbi_uc *pixels = stbi_load(job.inputPath.string().c_str(), &width, &height, nullptr, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        result.details = stbi_failure_reason();
+        return result;
+    }
+
+    // The runtime refuses larger cooked textures as corrupt
+    if (static_cast<uint32_t>(std::max(width, height)) > COOKED_TEXTURE_MAX_SIZE)
+    {
+        stbi_image_free(pixels);
+        result.details = "larger than " + std::to_string(COOKED_TEXTURE_MAX_SIZE) + " texels";
+        return result;
+    }
+
+    CookedTexture texture = buildMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    stbi_image_free(pixels);
+
+    if (formatOption == TEXTURE_FORMAT_OPTION_BC7)
+    {
+        texture = compressTexture(texture, COOKED_TEXTURE_FORMAT_BC7);
+    }
+    else if (formatOption == TEXTURE_FORMAT_OPTION_AUTO)
+    {
+        const CookedMipLevel &baseLevel = texture.mipLevels.front();
+        bool isOpaque = true;
+        for (uint64_t i = baseLevel.offset + 3; i < baseLevel.offset + baseLevel.size && isOpaque; i += 4)
+            isOpaque = texture.data[i] == 255;
+
+        texture = compressTexture(texture, isOpaque ? COOKED_TEXTURE_FORMAT_BC1 : COOKED_TEXTURE_FORMAT_BC3);
+    }
+
+    if (!saveCookedTexture(job.outputPath.string(), texture))
+    {
+        result.details = "failed to write output";
+        return result;
+    }
+
+    result.success = true;
+    result.details = std::to_string(width) + "x" + std::to_string(height) + ", " + std::to_string(texture.mipLevels.size()) + " mips, " + textureFormatName(texture.format);
+
+    return result;
+}
+
+static std::vector<CookJob> collectJobs(const std::filesystem::path &inputRoot, const std::filesystem::path &outputRoot)
+{
+    std::vector<CookJob> jobs;
+
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(inputRoot))
+    {
+        if (!entry.is_regular_file())
+            continue;
+
+        const std::string ext = toLower(entry.path().extension().string());
+        std::filesystem::path outputPath = outputRoot / entry.path().lexically_relative(inputRoot);
+
+        if (ext == ".obj")
+            jobs.push_back({COOK_JOB_TYPE_MODEL, entry.path(), outputPath.replace_extension(COOKED_MODEL_EXTENSION)});
+        else if (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp")
+            jobs.push_back({COOK_JOB_TYPE_TEXTURE, entry.path(), outputPath.replace_extension(COOKED_TEXTURE_EXTENSION)});
+    }
+
+    // Largest first so one big asset does not end up alone at the tail
+    std::sort(jobs.begin(), jobs.end(), [](const CookJob &a, const CookJob &b)
+              { return std::filesystem::file_size(a.inputPath) > std::filesystem::file_size(b.inputPath); });
+
+    return jobs;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << COOK_USAGE;
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path inputRoot = argv[1];
+    const std::filesystem::path outputRoot = argv[2];
+
+    uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    TextureFormatOption textureFormat = TEXTURE_FORMAT_OPTION_AUTO;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--threads" && i + 1 < argc)
+        {
+            const std::string count = argv[++i];
+
+            uint32_t parsedCount = 0;
+            const auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), parsedCount);
+            if (error != std::errc() || end != count.data() + count.size())
+            {
+                std::cerr << "Invalid thread count: " << count << '\n';
+                std::cerr << COOK_USAGE;
+                return EXIT_FAILURE;
+            }
+
+            threadCount = std::max(parsedCount, 1u);
+        }
+        else if (std::string(argv[i]) == "--texture-format" && i + 1 < argc)
+        {
+            const std::string format = toLower(argv[++i]);
+
+            if (format == "rgba8")
+                textureFormat = TEXTURE_FORMAT_OPTION_RGBA8;
+            else if (format == "bc7")
+                textureFormat = TEXTURE_FORMAT_OPTION_BC7;
+            else if (format != "auto")
+            {
+                std::cerr << "Unknown texture format: " << format << '\n';
+                std::cerr << COOK_USAGE;
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << argv[i] << '\n';
+            std::cerr << COOK_USAGE;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!std::filesystem::is_directory(inputRoot))
+    {
+        std::cerr << "Input directory not found: " << inputRoot.string() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<CookJob> jobs = collectJobs(inputRoot, outputRoot);
+
+    for (const CookJob &job : jobs)
+        std::filesystem::create_directories(job.outputPath.parent_path());
+
+    std::atomic<size_t> nextJob = 0;
+    std::atomic<size_t> failedJobCount = 0;
+    std::atomic<uint64_t> totalInputBytes = 0;
+    std::atomic<uint64_t> totalOutputBytes = 0;
+    std::mutex outputMutex;
+
+    const auto cookStart = std::chrono::steady_clock::now();
+
+    auto worker = [&]()
+    {
+        for (size_t jobIndex = nextJob++; jobIndex < jobs.size(); jobIndex = nextJob++)
+        {
+            const CookJob &job = jobs[jobIndex];
+
+            const auto jobStart = std::chrono::steady_clock::now();
+
+            // One malformed asset fails its own job, the rest still cook
+            CookResult result;
+            try
+            {
+                result = job.type == COOK_JOB_TYPE_MODEL ? cookModel(job) : cookTexture(job, textureFormat);
+            }
+            catch (const std::exception &exception)
+            {
+                result.details = std::string("exception: ") + exception.what();
+            }
+
+            const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+
+            result.inputBytes = std::filesystem::file_size(job.inputPath);
+            if (result.success)
+                result.outputBytes = std::filesystem::file_size(job.outputPath);
+            else
+                failedJobCount++;
+
+            totalInputBytes += result.inputBytes;
+            totalOutputBytes += result.outputBytes;
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << (result.success ? "[OK]   " : "[FAIL] ")
+                      << std::left << std::setw(48) << job.inputPath.lexically_relative(inputRoot).generic_string()
+                      << std::right << std::fixed << std::setprecision(1) << std::setw(9) << milliseconds << " ms  "
+                      << std::setw(10) << formatBytes(result.inputBytes) << " -> " << std::setw(10) << formatBytes(result.outputBytes)
+                      << "  " << result.details << '\n';
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+        workers.emplace_back(worker);
+
+    for (std::thread &thread : workers)
+        thread.join();
+
+    const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cookStart).count();
+
+    std::cout << "\nCooked " << jobs.size() - failedJobCount << '/' << jobs.size() << " assets on " << threadCount << " threads in "
+              << std::fixed << std::setprecision(2) << totalSeconds << " s (" << formatBytes(totalInputBytes) << " -> " << formatBytes(totalOutputBytes) << ")\n";
+
+    return failedJobCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
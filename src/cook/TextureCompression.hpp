@@ -0,0 +1,375 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "../shared/AssetFormat.hpp"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+
+namespace VE
+{
+
+    constexpr uint32_t TEXTURE_BLOCK_SIZE = 4;
+    constexpr uint32_t TEXTURE_BLOCK_TEXEL_COUNT = TEXTURE_BLOCK_SIZE * TEXTURE_BLOCK_SIZE;
+
+    // Interpolation weights of BC7 4-bit indices, out of 64
+    constexpr std::array<uint32_t, 16> BC7_INDEX_WEIGHTS = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    using TextureBlock = std::array<std::array<uint8_t, 4>, TEXTURE_BLOCK_TEXEL_COUNT>;
+
+    // Texels past the edge of a level repeat the last row and column
+    static void loadTextureBlock(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, TextureBlock &block)
+    {
+        for (uint32_t y = 0; y < TEXTURE_BLOCK_SIZE; y++)
+        {
+            const uint32_t pixelY = std::min(blockY * TEXTURE_BLOCK_SIZE + y, height - 1);
+
+            for (uint32_t x = 0; x < TEXTURE_BLOCK_SIZE; x++)
+            {
+                const uint32_t pixelX = std::min(blockX * TEXTURE_BLOCK_SIZE + x, width - 1);
+                const uint8_t *pixel = pixels + (static_cast<size_t>(pixelY) * width + pixelX) * 4;
+
+                block[y * TEXTURE_BLOCK_SIZE + x] = {pixel[0], pixel[1], pixel[2], pixel[3]};
+            }
+        }
+    }
+
+    // Endpoints at the extremes of the block's principal axis over the first channelCount channels
+    static void fitBlockEndpoints(const TextureBlock &block, uint32_t channelCount, std::array<float, 4> &low, std::array<float, 4> &high)
+    {
+        std::array<float, 4> mean = {};
+        for (const std::array<uint8_t, 4> &texel : block)
+            for (uint32_t c = 0; c < channelCount; c++)
+                mean[c] += texel[c] / static_cast<float>(TEXTURE_BLOCK_TEXEL_COUNT);
+
+        std::array<std::array<float, 4>, 4> covariance = {};
+        std::array<float, 4> minTexel = {255.0f, 255.0f, 255.0f, 255.0f};
+        std::array<float, 4> maxTexel = {};
+
+        for (const std::array<uint8_t, 4> &texel : block)
+        {
+            for (uint32_t i = 0; i < channelCount; i++)
+            {
+                minTexel[i] = std::min(minTexel[i], static_cast<float>(texel[i]));
+                maxTexel[i] = std::max(maxTexel[i], static_cast<float>(texel[i]));
+
+                for (uint32_t j = 0; j < channelCount; j++)
+                    covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+            }
+        }
+
+        // Power iteration from the bounding box diagonal, which is already close for most blocks
+        std::array<float, 4> axis = {};
+        for (uint32_t c = 0; c < channelCount; c++)
+            axis[c] = maxTexel[c] - minTexel[c];
+
+        for (uint32_t iteration = 0; iteration < 8; iteration++)
+        {
+            std::array<float, 4> next = {};
+            float length = 0.0f;
+
+            for (uint32_t i = 0; i < channelCount; i++)
+            {
+                for (uint32_t j = 0; j < channelCount; j++)
+                    next[i] += covariance[i][j] * axis[j];
+                length = std::max(length, std::abs(next[i]));
+            }
+
+            if (length == 0.0f)
+                break;
+
+            for (uint32_t c = 0; c < channelCount; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float axisLengthSquared = 0.0f;
+        for (uint32_t c = 0; c < channelCount; c++)
+            axisLengthSquared += axis[c] * axis[c];
+
+        // A flat block, both endpoints are its color
+        if (axisLengthSquared == 0.0f)
+        {
+            low = mean;
+            high = mean;
+            return;
+        }
+
+        float minProjection = std::numeric_limits<float>::max();
+        float maxProjection = std::numeric_limits<float>::lowest();
+
+        for (const std::array<uint8_t, 4> &texel : block)
+        {
+            float projection = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++)
+                projection += (texel[c] - mean[c]) * axis[c];
+
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        low = mean;
+        high = mean;
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            low[c] = std::clamp(mean[c] + axis[c] * minProjection / axisLengthSquared, 0.0f, 255.0f);
+            high[c] = std::clamp(mean[c] + axis[c] * maxProjection / axisLengthSquared, 0.0f, 255.0f);
+        }
+    }
+
+    // Index of the palette entry closest to texel over the first channelCount channels
+    template <size_t N>
+    [[nodiscard]] static uint32_t closestPaletteIndex(const std::array<std::array<int32_t, 4>, N> &palette, const std::array<uint8_t, 4> &texel, uint32_t channelCount)
+    {
+        uint32_t bestIndex = 0;
+        int32_t bestError = INT32_MAX;
+
+        for (uint32_t i = 0; i < N; i++)
+        {
+            int32_t error = 0;
+            for (uint32_t c = 0; c < channelCount; c++)
+                error += (palette[i][c] - texel[c]) * (palette[i][c] - texel[c]);
+
+            if (error < bestError)
+            {
+                bestError = error;
+                bestIndex = i;
+            }
+        }
+
+        return bestIndex;
+    }
+
+    [[nodiscard]] static uint16_t packRgb565(const std::array<float, 4> &color)
+    {
+        const uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+        const uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+        const uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    [[nodiscard]] static std::array<int32_t, 4> unpackRgb565(uint16_t color)
+    {
+        const int32_t r = (color >> 11) & 31;
+        const int32_t g = (color >> 5) & 63;
+        const int32_t b = color & 31;
+
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255};
+    }
+
+    // Always the four color mode, which is also how BC3 reads its color half
+    static void encodeBC1Block(const TextureBlock &block, uint8_t *output)
+    {
+        std::array<float, 4> low, high;
+        fitBlockEndpoints(block, 3, low, high);
+
+        uint16_t color0 = packRgb565(high);
+        uint16_t color1 = packRgb565(low);
+
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+
+        // Equal endpoints would select the three color mode, index 0 is right for every texel anyway
+        if (color0 != color1)
+        {
+            const std::array<int32_t, 4> endpoint0 = unpackRgb565(color0);
+            const std::array<int32_t, 4> endpoint1 = unpackRgb565(color1);
+
+            std::array<std::array<int32_t, 4>, 4> palette = {endpoint0, endpoint1};
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * endpoint0[c] + endpoint1[c]) / 3;
+                palette[3][c] = (endpoint0[c] + 2 * endpoint1[c]) / 3;
+            }
+
+            for (uint32_t i = 0; i < TEXTURE_BLOCK_TEXEL_COUNT; i++)
+                indices |= closestPaletteIndex(palette, block[i], 3) << (i * 2);
+        }
+
+        output[0] = static_cast<uint8_t>(color0);
+        output[1] = static_cast<uint8_t>(color0 >> 8);
+        output[2] = static_cast<uint8_t>(color1);
+        output[3] = static_cast<uint8_t>(color1 >> 8);
+        for (uint32_t i = 0; i < 4; i++)
+            output[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+
+    // Eight value mode between the block's alpha extremes
+    static void encodeBC3AlphaBlock(const TextureBlock &block, uint8_t *output)
+    {
+        uint8_t alpha0 = 0;
+        uint8_t alpha1 = 255;
+        for (const std::array<uint8_t, 4> &texel : block)
+        {
+            alpha0 = std::max(alpha0, texel[3]);
+            alpha1 = std::min(alpha1, texel[3]);
+        }
+
+        uint64_t indices = 0;
+
+        if (alpha0 != alpha1)
+        {
+            std::array<std::array<int32_t, 4>, 8> palette = {};
+            palette[0][0] = alpha0;
+            palette[1][0] = alpha1;
+            for (int32_t i = 1; i < 7; i++)
+                palette[i + 1][0] = ((7 - i) * alpha0 + i * alpha1) / 7;
+
+            for (uint32_t i = 0; i < TEXTURE_BLOCK_TEXEL_COUNT; i++)
+            {
+                const std::array<uint8_t, 4> alpha = {block[i][3]};
+                indices |= static_cast<uint64_t>(closestPaletteIndex(palette, alpha, 1)) << (i * 3);
+            }
+        }
+
+        output[0] = alpha0;
+        output[1] = alpha1;
+        for (uint32_t i = 0; i < 6; i++)
+            output[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+
+    static void encodeBC3Block(const TextureBlock &block, uint8_t *output)
+    {
+        encodeBC3AlphaBlock(block, output);
+        encodeBC1Block(block, output + 8);
+    }
+
+    // Least significant bit first, the order BC7 fields are laid out in
+    struct BlockBitWriter
+    {
+        uint8_t *output;
+        uint32_t bitOffset = 0;
+
+        void write(uint32_t value, uint32_t bitCount)
+        {
+            for (uint32_t i = 0; i < bitCount; i++, bitOffset++)
+                output[bitOffset / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (bitOffset % 8));
+        }
+    };
+
+    // Mode 6 only: one RGBA subset with 7 bit endpoints, a p-bit each and 4 bit indices
+    static void encodeBC7Block(const TextureBlock &block, uint8_t *output)
+    {
+        std::array<float, 4> low, high;
+        fitBlockEndpoints(block, 4, low, high);
+
+        // Each endpoint takes the p-bit that rounds it closer
+        std::array<std::array<uint32_t, 4>, 2> quantized;
+        std::array<uint32_t, 2> pBits;
+        std::array<std::array<int32_t, 4>, 2> endpoints;
+
+        const std::array<std::array<float, 4>, 2> targets = {low, high};
+        for (uint32_t e = 0; e < 2; e++)
+        {
+            float bestError = std::numeric_limits<float>::max();
+
+            for (uint32_t pBit = 0; pBit < 2; pBit++)
+            {
+                std::array<uint32_t, 4> candidate;
+                float error = 0.0f;
+
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((targets[e][c] - pBit) / 2.0f), 0l, 127l));
+                    const float value = static_cast<float>((candidate[c] << 1) | pBit);
+                    error += (value - targets[e][c]) * (value - targets[e][c]);
+                }
+
+                if (error < bestError)
+                {
+                    bestError = error;
+                    quantized[e] = candidate;
+                    pBits[e] = pBit;
+                }
+            }
+
+            for (uint32_t c = 0; c < 4; c++)
+                endpoints[e][c] = static_cast<int32_t>((quantized[e][c] << 1) | pBits[e]);
+        }
+
+        std::array<std::array<int32_t, 4>, 16> palette;
+        for (uint32_t i = 0; i < 16; i++)
+            for (uint32_t c = 0; c < 4; c++)
+                palette[i][c] = static_cast<int32_t>(((64 - BC7_INDEX_WEIGHTS[i]) * endpoints[0][c] + BC7_INDEX_WEIGHTS[i] * endpoints[1][c] + 32) >> 6);
+
+        std::array<uint32_t, TEXTURE_BLOCK_TEXEL_COUNT> indices;
+        for (uint32_t i = 0; i < TEXTURE_BLOCK_TEXEL_COUNT; i++)
+            indices[i] = closestPaletteIndex(palette, block[i], 4);
+
+        // The first index is stored without its top bit, swapping the endpoints clears it
+        if (indices[0] >= 8)
+        {
+            std::swap(quantized[0], quantized[1]);
+            std::swap(pBits[0], pBits[1]);
+            for (uint32_t &index : indices)
+                index = 15 - index;
+        }
+
+        std::fill(output, output + 16, 0);
+        BlockBitWriter writer = {output};
+
+        writer.write(1 << 6, 7);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            writer.write(quantized[0][c], 7);
+            writer.write(quantized[1][c], 7);
+        }
+        writer.write(pBits[0], 1);
+        writer.write(pBits[1], 1);
+
+        writer.write(indices[0], 3);
+        for (uint32_t i = 1; i < TEXTURE_BLOCK_TEXEL_COUNT; i++)
+            writer.write(indices[i], 4);
+    }
+
+    // Compresses every level of an RGBA8 texture, keeping the level sizes
+    [[nodiscard]] static CookedTexture compressTexture(const CookedTexture &source, CookedTextureFormat format)
+    {
+        CookedTexture texture;
+        texture.width = source.width;
+        texture.height = source.height;
+        texture.format = format;
+
+        const uint32_t blockBytes = cookedTextureBlockBytes(format);
+
+        for (const CookedMipLevel &sourceLevel : source.mipLevels)
+        {
+            const uint32_t blockCountX = (sourceLevel.width + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+            const uint32_t blockCountY = (sourceLevel.height + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+
+            CookedMipLevel mipLevel = {sourceLevel.width, sourceLevel.height, texture.data.size(), cookedMipLevelSize(format, sourceLevel.width, sourceLevel.height)};
+            texture.data.resize(mipLevel.offset + mipLevel.size);
+
+            const uint8_t *pixels = source.data.data() + sourceLevel.offset;
+            uint8_t *output = texture.data.data() + mipLevel.offset;
+
+            TextureBlock block;
+            for (uint32_t blockY = 0; blockY < blockCountY; blockY++)
+            {
+                for (uint32_t blockX = 0; blockX < blockCountX; blockX++, output += blockBytes)
+                {
+                    loadTextureBlock(pixels, sourceLevel.width, sourceLevel.height, blockX, blockY, block);
+
+                    if (format == COOKED_TEXTURE_FORMAT_BC1)
+                        encodeBC1Block(block, output);
+                    else if (format == COOKED_TEXTURE_FORMAT_BC3)
+                        encodeBC3Block(block, output);
+                    else
+                        encodeBC7Block(block, output);
+                }
+            }
+
+            texture.mipLevels.push_back(mipLevel);
+        }
+
+        return texture;
+    }
+
+}
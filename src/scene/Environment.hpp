@@ -20,6 +20,11 @@ namespace VE
         float gravityMps2 = 9.81f;
         float temperatureK = 293.15f;
         float outdoorBrightness = 1.0f;
+
+        // Directional light shining from sunDirection, off while sunStrength is 0
+        glm::vec3 sunDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+        color_t sunColor = color_t(1.0f);
+        float sunStrength = 0.0f;
     };
 
 }
\ No newline at end of file
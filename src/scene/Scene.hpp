@@ -53,6 +53,9 @@ namespace VE
         void setGravity(float gravity);
         void setBackgroundColor(color_t backgroundColor);
         void setOutdoorBrightness(float outdoorBrightness);
+        void setSun(glm::vec3 direction, color_t color, float strength);
+        void setMeshOptimization(bool isEnabled);
+        void setSurfaceMeshOptimization(bool isEnabled);
 
         void playAudio(std::string fileName, float pitch);
         void playAudio3D(std::string fileName, float pitch, Position3 position);
@@ -67,6 +70,9 @@ namespace VE
         std::vector<Model> models;
         std::vector<ModelInstance> modelInstances;
 
+        // Models loaded from files, keyed by normalized path so repeated loads share one Model
+        std::unordered_map<std::string, ModelHandle> modelHandlesByPath;
+
         // Actors
         std::vector<Vehicle> vehicles;
         std::vector<Prop> props;
@@ -84,17 +90,26 @@ namespace VE
         std::vector<LayeredEngineAudioRequest> layeredEngineAudioRequests;
         std::vector<AudioRequest> oneShotAudioRequests;
 
+        bool isMeshOptimizationEnabled = true;
+        bool isSurfaceMeshOptimizationEnabled = false;
+
+        void optimizeMeshes(std::vector<Mesh> &meshes) const;
+
         void setModelMat(ModelInstanceHandle modelInstanceHandle, glm::mat4 newModel);
 
-        [[nodiscard]] ModelInstanceHandle addModelInstance(ModelHandle modleHandle);
+        [[nodiscard]] ModelInstanceHandle addModelInstance(ModelHandle modleHandle, bool isDynamic = false);
 
         [[nodiscard]] bool isModelInstanced(ModelHandle modelHandle) const;
 
+        void removeUninstancedModels();
+
         [[nodiscard]] float sampleHeightAt(const Position3 &point) const;
         [[nodiscard]] const SurfaceType &sampleSurfaceTypeAt(const Position3 &point) const;
 
         bool vehicleRemovedThisFrame = false;
         bool modelRemovedThisFrame = false;
+
+        uint64_t staticInstanceVersion = 1;
     };
 
 }
\ No newline at end of file
@@ -18,7 +18,7 @@ namespace VE
             {
                 if (player->getHandle() == playerHandle)
                 {
-                    SceneDrawData drawData(models, modelInstances, player->getCameraViewMat(), environment.backgroundColor, environment.outdoorBrightness, modelRemovedThisFrame);
+                    SceneDrawData drawData(models, modelInstances, player->getCameraViewMat(), environment.backgroundColor, environment.outdoorBrightness, environment.sunDirection, environment.sunColor, environment.sunStrength, modelRemovedThisFrame, staticInstanceVersion);
                     return drawData;
                 }
             }
@@ -53,12 +53,15 @@ namespace VE
             if (instance.handle == modelInstanceHandle)
             {
                 instance.modelMat = modelMat;
+
+                if (!instance.isDynamic)
+                    staticInstanceVersion++;
                 break;
             }
         }
     }
 
-    ModelInstanceHandle Scene::addModelInstance(ModelHandle modelHandle)
+    ModelInstanceHandle Scene::addModelInstance(ModelHandle modelHandle, bool isDynamic)
     {
         if (modelHandle == INVALID_MODEL_HANDLE)
             Log::add('S', 201);
@@ -77,6 +80,10 @@ namespace VE
             Log::add('S', 201);
 
         modelInstances.emplace_back(HandleFactory<ModelInstanceHandle>::getNewHandle(), modelHandle, glm::mat4(1.0f));
+        modelInstances.back().isDynamic = isDynamic;
+
+        if (!isDynamic)
+            staticInstanceVersion++;
 
         return modelInstances.back().handle;
     }
@@ -94,6 +101,20 @@ namespace VE
         return false;
     }
 
+    void Scene::removeUninstancedModels()
+    {
+        size_t modelsRemoved = std::erase_if(models, [this](const auto &model)
+                                             { return !isModelInstanced(model.getHandle()); });
+        modelRemovedThisFrame = modelsRemoved > 0;
+
+        if (modelsRemoved > 0)
+        {
+            std::erase_if(modelHandlesByPath, [this](const auto &entry)
+                          { return std::none_of(models.begin(), models.end(), [&entry](const Model &model)
+                                                { return model.getHandle() == entry.second; }); });
+        }
+    }
+
     PlayerHandle Scene::addPlayer(VehicleHandle vehicleHandle)
     {
         PlayerHandle handle = HandleFactory<PlayerHandle>::getNewHandle();
@@ -110,11 +131,11 @@ namespace VE
         Vehicle newVehicle(handle,
                            transform,
                            info,
-                           addModelInstance(info.bodyModelHandle),
-                           addModelInstance(info.wheelModelHandle),
-                           addModelInstance(info.wheelModelHandle),
-                           addModelInstance(info.wheelModelHandle),
-                           addModelInstance(info.wheelModelHandle));
+                           addModelInstance(info.bodyModelHandle, true),
+                           addModelInstance(info.wheelModelHandle, true),
+                           addModelInstance(info.wheelModelHandle, true),
+                           addModelInstance(info.wheelModelHandle, true),
+                           addModelInstance(info.wheelModelHandle, true));
 
         if (!info.engineAudioFileName.empty())
         {
@@ -242,9 +263,7 @@ namespace VE
                           { return modelInstance.handle == wheelModelInstanceHandle; });
         }
 
-        size_t modelsRemoved = std::erase_if(models, [this](const auto &model)
-                                             { return !isModelInstanced(model.getHandle()); });
-        modelRemovedThisFrame = modelsRemoved > 0;
+        removeUninstancedModels();
 
         std::erase_if(vehicles, [handle](const auto &vehicle)
                       { return vehicle.getHandle() == handle; });
@@ -263,10 +282,9 @@ namespace VE
         const ModelInstanceHandle modelInstanceHandle = prop(handle).getModelInstanceHandle();
         std::erase_if(modelInstances, [modelInstanceHandle](const auto &modelInstance)
                       { return modelInstance.handle == modelInstanceHandle; });
+        staticInstanceVersion++;
 
-        size_t modelsRemoved = std::erase_if(models, [this](const auto &model)
-                                             { return !isModelInstanced(model.getHandle()); });
-        modelRemovedThisFrame = modelsRemoved > 0;
+        removeUninstancedModels();
 
         std::erase_if(props, [handle](const auto &prop)
                       { return prop.getHandle() == handle; });
@@ -277,10 +295,9 @@ namespace VE
         const ModelInstanceHandle modelInstanceHandle = trigger(handle).getModelInstanceHandle();
         std::erase_if(modelInstances, [modelInstanceHandle](const auto &modelInstance)
                       { return modelInstance.handle == modelInstanceHandle; });
+        staticInstanceVersion++;
 
-        size_t modelsRemoved = std::erase_if(models, [this](const auto &model)
-                                             { return !isModelInstanced(model.getHandle()); });
-        modelRemovedThisFrame = modelsRemoved > 0;
+        removeUninstancedModels();
 
         std::erase_if(triggers, [handle](const auto &trigger)
                       { return trigger.getHandle() == handle; });
@@ -411,6 +428,10 @@ namespace VE
             meshes.emplace_back(verticesByType[surfaceTypeIndex], indicesByType[surfaceTypeIndex], surfaceTypeIndex, Mesh::NO_TEXTURE);
         }
 
+        // Terrain is generated on the calling thread and can be large, so the pass is opt-in here
+        if (isSurfaceMeshOptimizationEnabled)
+            optimizeMeshes(meshes);
+
         Model newModel(newModelHandle, meshes, materials);
 
         models.push_back(newModel);
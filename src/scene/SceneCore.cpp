@@ -6,9 +6,13 @@
 #include "../shared/HandleFactory.hpp"
 
 #include "../shared/MeshLoader.hpp"
+#include "../shared/MeshOptimizer.hpp"
+#include "../shared/AssetFormat.hpp"
 #include "../shared/Log.hpp"
+#include "../shared/local.hpp"
 
 #include <vector>
+#include <iostream>
 
 namespace VE
 {
@@ -220,16 +224,30 @@ namespace VE
 
     ModelHandle Scene::addModel(const std::string &filePath)
     {
+        const std::string pathKey = std::filesystem::path(filePath).lexically_normal().generic_string();
+
+        if (auto it = modelHandlesByPath.find(pathKey); it != modelHandlesByPath.end())
+            return it->second;
+
         std::string ext = std::filesystem::path(filePath).extension().string();
 
-        if (ext != ".obj")
+        ModelData data;
+
+        if (ext == COOKED_MODEL_EXTENSION)
+        {
+            data = loadCookedModel(filePath);
+        }
+        else if (ext == ".obj" && !COOKED_ASSETS_ONLY)
+        {
+            data = loadOBJ(filePath);
+            optimizeMeshes(data.meshes);
+        }
+        else
         {
             Log::add('E', 101);
             return INVALID_MODEL_HANDLE;
         }
 
-        ModelData data = loadOBJ(filePath);
-
         if (data.meshes.empty())
         {
             Log::add('E', 102);
@@ -239,10 +257,27 @@ namespace VE
         ModelHandle newModelHandle = HandleFactory<ModelHandle>::getNewHandle();
 
         models.emplace_back(newModelHandle, data.meshes, data.materials);
+        modelHandlesByPath.emplace(pathKey, newModelHandle);
 
         return newModelHandle;
     }
 
+    void Scene::optimizeMeshes(std::vector<Mesh> &meshes) const
+    {
+        if (!isMeshOptimizationEnabled)
+            return;
+
+        for (Mesh &mesh : meshes)
+        {
+            Mesh optimizedMesh = optimizeMesh(mesh);
+
+            if (DEVELOPER_MODE)
+                std::cout << "Mesh ACMR: " << computeACMR(mesh.getIndices(), mesh.getVertices().size()) << " -> " << computeACMR(optimizedMesh.getIndices(), optimizedMesh.getVertices().size()) << std::endl;
+
+            mesh = std::move(optimizedMesh);
+        }
+    }
+
     float Scene::sampleHeightAt(const Position3 &point) const
     {
         float highest = 0;
@@ -319,6 +354,25 @@ namespace VE
         environment.outdoorBrightness = outdoorBrightness;
     }
 
+    void Scene::setSun(glm::vec3 direction, color_t color, float strength)
+    {
+        if (glm::length(direction) > 0.0f)
+            environment.sunDirection = glm::normalize(direction);
+
+        environment.sunColor = color;
+        environment.sunStrength = strength;
+    }
+
+    void Scene::setMeshOptimization(bool isEnabled)
+    {
+        isMeshOptimizationEnabled = isEnabled;
+    }
+
+    void Scene::setSurfaceMeshOptimization(bool isEnabled)
+    {
+        isSurfaceMeshOptimizationEnabled = isEnabled;
+    }
+
     void Scene::playAudio(std::string fileName, float pitch)
     {
         oneShotAudioRequests.emplace_back(AudioRequest{fileName, pitch, false, {}});
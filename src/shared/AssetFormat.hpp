@@ -0,0 +1,315 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "DrawData.hpp"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+namespace VE
+{
+
+    inline const std::string COOKED_MODEL_EXTENSION = ".vmodel";
+    inline const std::string COOKED_TEXTURE_EXTENSION = ".vtex";
+
+    constexpr uint32_t COOKED_MODEL_MAGIC = 0x444D4556;   // "VEMD"
+    constexpr uint32_t COOKED_TEXTURE_MAGIC = 0x58544556; // "VETX"
+
+    // Bumped separately, so a change to one container doesn't invalidate files of the other
+    constexpr uint32_t COOKED_MODEL_VERSION = 2;
+    constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+
+    enum CookedTextureFormat : uint32_t
+    {
+        COOKED_TEXTURE_FORMAT_RGBA8,
+
+        // 4x4 blocks, BC1 for opaque textures and BC3 or BC7 when they have alpha
+        COOKED_TEXTURE_FORMAT_BC1,
+        COOKED_TEXTURE_FORMAT_BC3,
+        COOKED_TEXTURE_FORMAT_BC7
+    };
+
+    // Larger headers are taken as corrupt instead of sizing an allocation from them
+    constexpr uint32_t COOKED_TEXTURE_MAX_SIZE = 16384;
+    constexpr uint32_t COOKED_TEXTURE_MAX_MIP_LEVELS = 15;
+    constexpr uint32_t COOKED_MODEL_MAX_TEXTURE_PATH_LENGTH = 4096;
+
+    // Sizes are in texels, offsets and sizes in bytes of the texture's format
+    struct CookedMipLevel
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct CookedTexture
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        CookedTextureFormat format = COOKED_TEXTURE_FORMAT_RGBA8;
+
+        // All mip levels packed back to back, largest first
+        std::vector<CookedMipLevel> mipLevels;
+        std::vector<uint8_t> data;
+
+        // Index of mipLevels[0] in the full chain, nonzero when only the lower levels were loaded
+        uint32_t firstMipLevel = 0;
+    };
+
+    struct CookedModelHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t meshCount;
+        uint32_t materialCount;
+    };
+
+    struct CookedMeshHeader
+    {
+        uint32_t materialIndex;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexType;
+        uint32_t texturePathLength;
+    };
+
+    struct CookedTextureHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint32_t mipLevelCount;
+    };
+
+    [[nodiscard]] static uint32_t cookedTextureBlockBytes(CookedTextureFormat format)
+    {
+        return format == COOKED_TEXTURE_FORMAT_BC1 ? 8 : 16;
+    }
+
+    [[nodiscard]] static uint64_t cookedMipLevelSize(CookedTextureFormat format, uint32_t width, uint32_t height)
+    {
+        if (format == COOKED_TEXTURE_FORMAT_RGBA8)
+            return static_cast<uint64_t>(width) * height * 4;
+
+        return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * cookedTextureBlockBytes(format);
+    }
+
+    template <typename T>
+    static void writeCookedPod(std::ofstream &file, const T &value)
+    {
+        file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void writeCookedArray(std::ofstream &file, const std::vector<T> &values)
+    {
+        file.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(sizeof(T) * values.size()));
+    }
+
+    template <typename T>
+    [[nodiscard]] static bool readCookedPod(std::ifstream &file, T &value)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+
+    template <typename T>
+    [[nodiscard]] static bool readCookedArray(std::ifstream &file, std::vector<T> &values, size_t count)
+    {
+        values.resize(count);
+        return static_cast<bool>(file.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(sizeof(T) * count)));
+    }
+
+    // Bytes between the read position and the end of the file, 0 if the stream has failed
+    [[nodiscard]] static uint64_t cookedBytesLeft(std::ifstream &file, std::streampos fileEnd)
+    {
+        const std::streampos position = file.tellg();
+        return position < 0 || position > fileEnd ? 0 : static_cast<uint64_t>(fileEnd - position);
+    }
+
+    // Texture paths are stored relative to the cooked model file
+    [[nodiscard]] static bool saveCookedModel(const std::string &filePath, const ModelData &data)
+    {
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        writeCookedPod(file, CookedModelHeader{COOKED_MODEL_MAGIC, COOKED_MODEL_VERSION, static_cast<uint32_t>(data.meshes.size()), static_cast<uint32_t>(data.materials.size())});
+
+        writeCookedArray(file, data.materials);
+
+        for (const Mesh &mesh : data.meshes)
+        {
+            const std::string &texturePath = mesh.getTextureFilePath();
+
+            writeCookedPod(file, CookedMeshHeader{mesh.getMaterialIndex(), static_cast<uint32_t>(mesh.getVertices().size()), static_cast<uint32_t>(mesh.getIndices().size()), mesh.getIndexType(), static_cast<uint32_t>(texturePath.size())});
+
+            file.write(texturePath.data(), static_cast<std::streamsize>(texturePath.size()));
+            writeCookedArray(file, mesh.getVertices());
+
+            if (mesh.getIndexType() == MESH_INDEX_TYPE_UINT16)
+                writeCookedArray(file, std::vector<uint16_t>(mesh.getIndices().begin(), mesh.getIndices().end()));
+            else
+                writeCookedArray(file, mesh.getIndices());
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    [[nodiscard]] static ModelData loadCookedModel(const std::string &filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+            return {};
+
+        file.seekg(0, std::ios::end);
+        const std::streampos fileEnd = file.tellg();
+        file.seekg(0);
+
+        // Every count is checked against what is left of the file before allocating
+        CookedModelHeader header;
+        if (!readCookedPod(file, header) || header.magic != COOKED_MODEL_MAGIC || header.version != COOKED_MODEL_VERSION ||
+            header.materialCount > cookedBytesLeft(file, fileEnd) / sizeof(Material))
+            return {};
+
+        ModelData data;
+
+        if (!readCookedArray(file, data.materials, header.materialCount) || header.meshCount > cookedBytesLeft(file, fileEnd) / sizeof(CookedMeshHeader))
+            return {};
+
+        const std::filesystem::path modelDirectory = std::filesystem::path(filePath).parent_path();
+
+        data.meshes.reserve(header.meshCount);
+        for (uint32_t i = 0; i < header.meshCount; i++)
+        {
+            CookedMeshHeader meshHeader;
+            if (!readCookedPod(file, meshHeader) || meshHeader.materialIndex >= data.materials.size() ||
+                (meshHeader.indexType != MESH_INDEX_TYPE_UINT16 && meshHeader.indexType != MESH_INDEX_TYPE_UINT32) ||
+                meshHeader.texturePathLength > COOKED_MODEL_MAX_TEXTURE_PATH_LENGTH || meshHeader.indexCount % 3 != 0)
+                return {};
+
+            const uint64_t indexBytes = meshHeader.indexType == MESH_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+            const uint64_t meshBytes = meshHeader.texturePathLength + static_cast<uint64_t>(meshHeader.vertexCount) * sizeof(Vertex) + meshHeader.indexCount * indexBytes;
+            if (meshBytes > cookedBytesLeft(file, fileEnd))
+                return {};
+
+            std::string texturePath(meshHeader.texturePathLength, '\0');
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+
+            if (!file.read(texturePath.data(), meshHeader.texturePathLength) ||
+                !readCookedArray(file, vertices, meshHeader.vertexCount))
+                return {};
+
+            if (meshHeader.indexType == MESH_INDEX_TYPE_UINT16)
+            {
+                std::vector<uint16_t> shortIndices;
+                if (!readCookedArray(file, shortIndices, meshHeader.indexCount))
+                    return {};
+
+                indices.assign(shortIndices.begin(), shortIndices.end());
+            }
+            else if (!readCookedArray(file, indices, meshHeader.indexCount))
+                return {};
+
+            if (std::any_of(indices.begin(), indices.end(), [&](uint32_t index)
+                            { return index >= meshHeader.vertexCount; }))
+                return {};
+
+            if (!texturePath.empty())
+                texturePath = (modelDirectory / texturePath).string();
+
+            data.meshes.emplace_back(vertices, indices, meshHeader.materialIndex, texturePath);
+        }
+
+        return data;
+    }
+
+    [[nodiscard]] static bool saveCookedTexture(const std::string &filePath, const CookedTexture &texture)
+    {
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        writeCookedPod(file, CookedTextureHeader{COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION, texture.width, texture.height, texture.format, static_cast<uint32_t>(texture.mipLevels.size())});
+
+        writeCookedArray(file, texture.mipLevels);
+        writeCookedArray(file, texture.data);
+
+        return static_cast<bool>(file);
+    }
+
+    // Loads levels [firstLevel, firstLevel + levelCount) of the chain, clamped to the levels the file has,
+    // so streaming can read only the levels it is missing
+    [[nodiscard]] static CookedTexture loadCookedTexture(const std::string &filePath, uint32_t firstLevel = 0, uint32_t levelCount = COOKED_TEXTURE_MAX_MIP_LEVELS)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+            return {};
+
+        CookedTextureHeader header;
+        if (!readCookedPod(file, header) || header.magic != COOKED_TEXTURE_MAGIC || header.version != COOKED_TEXTURE_VERSION)
+            return {};
+
+        if (header.width == 0 || header.width > COOKED_TEXTURE_MAX_SIZE || header.height == 0 || header.height > COOKED_TEXTURE_MAX_SIZE ||
+            header.format > COOKED_TEXTURE_FORMAT_BC7 || header.mipLevelCount == 0 || header.mipLevelCount > COOKED_TEXTURE_MAX_MIP_LEVELS)
+            return {};
+
+        CookedTexture texture;
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.format = static_cast<CookedTextureFormat>(header.format);
+
+        if (!readCookedArray(file, texture.mipLevels, header.mipLevelCount))
+            return {};
+
+        // Levels halve down from the header size and are packed back to back, anything else is a corrupt file
+        uint64_t dataSize = 0;
+        for (uint32_t mipIndex = 0; mipIndex < header.mipLevelCount; mipIndex++)
+        {
+            const CookedMipLevel &mipLevel = texture.mipLevels[mipIndex];
+
+            if (mipLevel.width != std::max(header.width >> mipIndex, 1u) || mipLevel.height != std::max(header.height >> mipIndex, 1u) ||
+                mipLevel.offset != dataSize || mipLevel.size != cookedMipLevelSize(texture.format, mipLevel.width, mipLevel.height))
+                return {};
+
+            dataSize += mipLevel.size;
+        }
+
+        // Checked against what is left of the file before allocating
+        const std::streampos dataBegin = file.tellg();
+        file.seekg(0, std::ios::end);
+        const std::streampos fileEnd = file.tellg();
+        file.seekg(dataBegin);
+
+        if (dataBegin < 0 || static_cast<uint64_t>(fileEnd - dataBegin) < dataSize || firstLevel >= header.mipLevelCount || levelCount == 0)
+            return {};
+
+        const uint32_t lastLevel = firstLevel + std::min(levelCount, header.mipLevelCount - firstLevel);
+        if (firstLevel > 0 || lastLevel < header.mipLevelCount)
+        {
+            texture.mipLevels = std::vector<CookedMipLevel>(texture.mipLevels.begin() + firstLevel, texture.mipLevels.begin() + lastLevel);
+            texture.firstMipLevel = firstLevel;
+
+            const uint64_t rangeBegin = texture.mipLevels.front().offset;
+            dataSize = texture.mipLevels.back().offset + texture.mipLevels.back().size - rangeBegin;
+            for (CookedMipLevel &mipLevel : texture.mipLevels)
+                mipLevel.offset -= rangeBegin;
+
+            file.seekg(dataBegin + static_cast<std::streamoff>(rangeBegin));
+        }
+
+        if (!readCookedArray(file, texture.data, dataSize))
+            return {};
+
+        return texture;
+    }
+
+}
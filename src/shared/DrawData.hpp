@@ -6,6 +6,9 @@
 #include "definitions.hpp"
 
 #include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
 
 namespace VE
 {
@@ -19,6 +22,14 @@ namespace VE
         Vertex(const glm::vec3 &position = glm::vec3(0.0f), const glm::vec2 &texture = glm::vec2(0.0f), const glm::vec3 &normal = glm::vec3(0.0f, 1.0f, 0.0f)) : pos(position), tex(texture), norm(normal) {}
     };
 
+    // Unorm16 position inside the mesh bounds, octahedral snorm16 normal, half float texture coordinates
+    struct PackedVertex
+    {
+        uint16_t pos[4];
+        int16_t norm[2];
+        uint16_t tex[2];
+    };
+
     struct Material
     {
         color_t baseColor;
@@ -26,15 +37,35 @@ namespace VE
         float roughness;
     };
 
+    enum MeshIndexType : uint32_t
+    {
+        MESH_INDEX_TYPE_UINT16,
+        MESH_INDEX_TYPE_UINT32
+    };
+
+    // Meshes up to this many vertices are addressed with 16-bit indices on the GPU
+    constexpr size_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+
+    // Bounding sphere in mesh space, centered on the vertices' bounding box
+    struct MeshBounds
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+    };
+
     class Mesh
     {
     public:
-        Mesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, uint32_t materialIndex, const std::string &textureFilePath) : vertices(vertices), indices(indices), materialIndex(materialIndex), textureFilePath(textureFilePath) {}
+        Mesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, uint32_t materialIndex, const std::string &textureFilePath)
+            : vertices(vertices), indices(indices), materialIndex(materialIndex), textureFilePath(textureFilePath),
+              indexType(vertices.size() <= SHORT_INDEX_VERTEX_LIMIT ? MESH_INDEX_TYPE_UINT16 : MESH_INDEX_TYPE_UINT32), bounds(computeBounds(vertices)) {}
 
         [[nodiscard]] const std::vector<Vertex> &getVertices() const { return vertices; }
         [[nodiscard]] const std::vector<uint32_t> &getIndices() const { return indices; }
         [[nodiscard]] uint32_t getMaterialIndex() const { return materialIndex; }
         [[nodiscard]] const std::string &getTextureFilePath() const { return textureFilePath; }
+        [[nodiscard]] MeshIndexType getIndexType() const { return indexType; }
+        [[nodiscard]] const MeshBounds &getBounds() const { return bounds; }
 
         static inline const std::string NO_TEXTURE = "";
 
@@ -43,6 +74,35 @@ namespace VE
         std::vector<uint32_t> indices;
         uint32_t materialIndex;
         std::string textureFilePath;
+        MeshIndexType indexType;
+        MeshBounds bounds;
+
+        [[nodiscard]] static MeshBounds computeBounds(const std::vector<Vertex> &vertices)
+        {
+            MeshBounds meshBounds;
+            if (vertices.empty())
+                return meshBounds;
+
+            glm::vec3 minPos = vertices.front().pos;
+            glm::vec3 maxPos = vertices.front().pos;
+            for (const Vertex &vertex : vertices)
+            {
+                minPos = glm::min(minPos, vertex.pos);
+                maxPos = glm::max(maxPos, vertex.pos);
+            }
+
+            meshBounds.center = (minPos + maxPos) * 0.5f;
+
+            float radiusSquared = 0.0f;
+            for (const Vertex &vertex : vertices)
+            {
+                const glm::vec3 offset = vertex.pos - meshBounds.center;
+                radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+            }
+            meshBounds.radius = std::sqrt(radiusSquared);
+
+            return meshBounds;
+        }
     };
 
     struct ModelData
@@ -54,18 +114,18 @@ namespace VE
     class Model
     {
     public:
-        Model(ModelHandle handle, const std::vector<Mesh> &meshes, const std::vector<Material> &materials) : handle(handle), meshes(meshes), materials(materials) {}
+        Model(ModelHandle handle, const std::vector<Mesh> &meshes, const std::vector<Material> &materials) : handle(handle), meshes(std::make_shared<const std::vector<Mesh>>(meshes)), materials(materials) {}
 
         void update(const std::vector<Mesh> &meshes)
         {
-            this->meshes = meshes;
+            this->meshes = std::make_shared<const std::vector<Mesh>>(meshes);
 
             version++;
         }
 
         [[nodiscard]] ModelHandle getHandle() const { return handle; };
         [[nodiscard]] uint64_t getVersion() const { return version; }
-        [[nodiscard]] const std::vector<Mesh> &getMeshes() const { return meshes; }
+        [[nodiscard]] const std::vector<Mesh> &getMeshes() const { return *meshes; }
         [[nodiscard]] const std::vector<Material> &getMaterials() const { return materials; }
 
     private:
@@ -73,7 +133,8 @@ namespace VE
 
         uint64_t version = 1;
 
-        std::vector<Mesh> meshes;
+        // Shared so the renderer can hold a snapshot of a version while it uploads in the background
+        std::shared_ptr<const std::vector<Mesh>> meshes;
         std::vector<Material> materials;
     };
 
@@ -88,6 +149,9 @@ namespace VE
         float lightStrength = 0.0f;
         color_t lightColor = color_t(1.0f);
 
+        // Moves every frame, so the renderer draws its shadow on top of the cached static shadows instead of into them
+        bool isDynamic = false;
+
         ModelInstance(ModelInstanceHandle handle, ModelHandle modelHandle, glm::mat4 modelMat, float lightStrength = 0.0f, color_t lightColor = color_t(1.0f))
             : handle(handle), modelHandle(modelHandle), modelMat(modelMat), lightStrength(lightStrength), lightColor(lightColor) {}
     };
@@ -141,15 +205,27 @@ namespace VE
 
         const float outdoorBrightness;
 
+        // Towards the sun, see Environment
+        const glm::vec3 sunDirection;
+        const color_t sunColor;
+        const float sunStrength;
+
         const bool modelRemovedThisFrame;
 
+        // Changes whenever a static instance is added, removed or moved
+        const uint64_t staticInstanceVersion;
+
         SceneDrawData(const std::vector<Model> &models,
                       const std::vector<ModelInstance> &modelInstances,
                       const glm::mat4 viewMat,
                       const color_t backgroundColor,
                       const float outdoorBrightness,
-                      const bool modelRemovedThisFrame)
-            : models(models), modelInstances(modelInstances), viewMat(viewMat), backgroundColor(backgroundColor), outdoorBrightness(outdoorBrightness), modelRemovedThisFrame(modelRemovedThisFrame) {}
+                      const glm::vec3 sunDirection,
+                      const color_t sunColor,
+                      const float sunStrength,
+                      const bool modelRemovedThisFrame,
+                      const uint64_t staticInstanceVersion)
+            : models(models), modelInstances(modelInstances), viewMat(viewMat), backgroundColor(backgroundColor), outdoorBrightness(outdoorBrightness), sunDirection(sunDirection), sunColor(sunColor), sunStrength(sunStrength), modelRemovedThisFrame(modelRemovedThisFrame), staticInstanceVersion(staticInstanceVersion) {}
     };
 
     struct UIDrawData
@@ -30,6 +30,10 @@ inline static const std::map<std::pair<char, uint16_t>, std::string> LOG_MESSAGE
     {{'V', 104}, "Vulkan returned: VK_EVENT_RESET"},
     {{'V', 110}, "Failed to write to pipeline cache file"},
     {{'V', 111}, "STB Image failed to load image"},
+    {{'V', 112}, "Failed to load cooked texture"},
+    {{'V', 113}, "Texture array is full, using the fallback texture"},
+    {{'V', 114}, "Cooked texture format not supported by the GPU"},
+    {{'V', 115}, "Skipped a GPU without a required Vulkan feature"},
 
     {{'V', 200}, "Vulkan failed to create instance"},
     {{'V', 201}, "Vulkan failed to create window surface"},
@@ -59,6 +63,7 @@ inline static const std::map<std::pair<char, uint16_t>, std::string> LOG_MESSAGE
     // {{'V', 225} removed
     {{'V', 226}, "Vulkan failed to create sampler"},
     {{'V', 227}, "Vulkan failed to create pipeline cache"},
+    {{'V', 228}, "Vulkan upload batch begun while another is open on the same upload context"},
     {{'V', 229}, "Vulkan failed to initialize mesh"},
     {{'V', 230}, "Vulkan failed to acquire swapchain image"},
     {{'V', 231}, "Vulkan failed to wait for fence"},
@@ -72,6 +77,8 @@ inline static const std::map<std::pair<char, uint16_t>, std::string> LOG_MESSAGE
     {{'V', 239}, "Vulkan failed to copy image"},
     {{'V', 240}, "Vulkan failed to transition image layout"},
     {{'V', 241}, "Vulkan failed to generate mipmaps"},
+    {{'V', 242}, "Vulkan failed to allocate memory"},
+    {{'V', 243}, "Vulkan failed to wait for semaphore"},
 
     // Renderer
     {{'R', 200}, "Renderer: invalid Field Of View value"},
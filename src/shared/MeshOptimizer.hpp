@@ -0,0 +1,344 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include "DrawData.hpp"
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include <glm/gtc/packing.hpp>
+
+namespace VE
+{
+
+    constexpr uint32_t OPTIMIZER_VERTEX_CACHE_SIZE = 32;
+    constexpr uint32_t ACMR_VERTEX_CACHE_SIZE = 16;
+
+    // Largest mesh extent that still quantizes to roughly a millimeter
+    constexpr float PACKED_VERTEX_MAX_EXTENT = 64.0f;
+
+    // Half floats step by 2^-10 up to this, within half a texel of a 1024 texture, tiled coordinates past it keep full precision
+    constexpr float PACKED_VERTEX_MAX_TEXCOORD = 2.0f;
+
+    struct PackedMesh
+    {
+        std::vector<PackedVertex> vertices;
+
+        // Maps unorm positions back to mesh space, uniform so normals stay valid
+        glm::mat4 dequantizeMat = glm::mat4(1.0f);
+    };
+
+    struct VertexBitsHash
+    {
+        size_t operator()(const Vertex &vertex) const
+        {
+            uint32_t bits[sizeof(Vertex) / sizeof(uint32_t)];
+            std::memcpy(bits, &vertex, sizeof(Vertex));
+
+            size_t hash = 0;
+            for (uint32_t word : bits)
+                hash ^= std::hash<uint32_t>{}(word) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+            return hash;
+        }
+    };
+
+    struct VertexBitsEqual
+    {
+        bool operator()(const Vertex &a, const Vertex &b) const
+        {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    // Merges bitwise identical vertices and remaps the index buffer
+    [[nodiscard]] static Mesh weldVertices(const Mesh &mesh)
+    {
+        const std::vector<Vertex> &vertices = mesh.getVertices();
+        const std::vector<uint32_t> &indices = mesh.getIndices();
+
+        std::unordered_map<Vertex, uint32_t, VertexBitsHash, VertexBitsEqual> uniqueVertices;
+        uniqueVertices.reserve(vertices.size());
+
+        std::vector<Vertex> weldedVertices;
+        weldedVertices.reserve(vertices.size());
+
+        std::vector<uint32_t> remap(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto [it, inserted] = uniqueVertices.try_emplace(vertices[i], static_cast<uint32_t>(weldedVertices.size()));
+            if (inserted)
+                weldedVertices.push_back(vertices[i]);
+
+            remap[i] = it->second;
+        }
+
+        std::vector<uint32_t> weldedIndices(indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+            weldedIndices[i] = remap[indices[i]];
+
+        return Mesh(weldedVertices, weldedIndices, mesh.getMaterialIndex(), mesh.getTextureFilePath());
+    }
+
+    // Average cache miss ratio: transformed vertices per triangle with a FIFO post-transform cache
+    [[nodiscard]] static float computeACMR(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = ACMR_VERTEX_CACHE_SIZE)
+    {
+        if (indices.size() < 3)
+            return 0.0f;
+
+        std::vector<uint32_t> insertedAt(vertexCount, UINT32_MAX);
+        uint32_t missCount = 0;
+
+        for (uint32_t index : indices)
+        {
+            if (insertedAt[index] == UINT32_MAX || missCount - insertedAt[index] >= cacheSize)
+            {
+                insertedAt[index] = missCount;
+                missCount++;
+            }
+        }
+
+        return static_cast<float>(missCount) / static_cast<float>(indices.size() / 3);
+    }
+
+    // Tom Forsyth's linear-speed vertex cache optimization
+    [[nodiscard]] static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return indices;
+
+        constexpr uint32_t VALENCE_TABLE_SIZE = 32;
+
+        float cacheScoreTable[OPTIMIZER_VERTEX_CACHE_SIZE];
+        for (uint32_t i = 0; i < OPTIMIZER_VERTEX_CACHE_SIZE; i++)
+            cacheScoreTable[i] = i < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(i - 3) / (OPTIMIZER_VERTEX_CACHE_SIZE - 3), 1.5f);
+
+        float valenceScoreTable[VALENCE_TABLE_SIZE];
+        for (uint32_t i = 1; i < VALENCE_TABLE_SIZE; i++)
+            valenceScoreTable[i] = 2.0f / std::sqrt(static_cast<float>(i));
+
+        const auto vertexScore = [&](int32_t cachePosition, uint32_t liveTriangleCount) -> float
+        {
+            if (liveTriangleCount == 0)
+                return -1.0f;
+
+            float score = cachePosition >= 0 ? cacheScoreTable[cachePosition] : 0.0f;
+
+            return score + (liveTriangleCount < VALENCE_TABLE_SIZE ? valenceScoreTable[liveTriangleCount] : 2.0f / std::sqrt(static_cast<float>(liveTriangleCount)));
+        };
+
+        // Triangles adjacent to each vertex, live ones are kept at the front of each range
+        std::vector<uint32_t> liveTriangleCounts(vertexCount, 0);
+        for (uint32_t index : indices)
+            liveTriangleCounts[index]++;
+
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; i++)
+            adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangleCounts[i];
+
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<int32_t> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            vertexScores[i] = vertexScore(-1, liveTriangleCounts[i]);
+
+        std::vector<bool> emitted(triangleCount, false);
+
+        uint32_t bestTriangle = 0;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < triangleCount; i++)
+        {
+            float score = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestTriangle = static_cast<uint32_t>(i);
+            }
+        }
+
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> nextCache;
+        cache.reserve(OPTIMIZER_VERTEX_CACHE_SIZE + 3);
+        nextCache.reserve(OPTIMIZER_VERTEX_CACHE_SIZE + 3);
+
+        std::vector<uint32_t> optimized;
+        optimized.reserve(indices.size());
+
+        // Marks vertices already placed in the next cache during the current step
+        std::vector<size_t> placedAtStep(vertexCount, SIZE_MAX);
+
+        size_t deadEndCursor = 0;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            // Nothing useful left in the cache, continue from the first pending triangle
+            if (bestScore < 0.0f)
+            {
+                while (emitted[deadEndCursor])
+                    deadEndCursor++;
+                bestTriangle = static_cast<uint32_t>(deadEndCursor);
+            }
+
+            emitted[bestTriangle] = true;
+
+            nextCache.clear();
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[bestTriangle * 3 + corner];
+                optimized.push_back(vertex);
+
+                uint32_t *first = adjacency.data() + adjacencyOffsets[vertex];
+                uint32_t *last = first + liveTriangleCounts[vertex];
+                *std::find(first, last, bestTriangle) = *(last - 1);
+                liveTriangleCounts[vertex]--;
+
+                if (placedAtStep[vertex] != emittedCount)
+                {
+                    placedAtStep[vertex] = emittedCount;
+                    nextCache.push_back(vertex);
+                }
+            }
+
+            for (uint32_t vertex : cache)
+            {
+                if (placedAtStep[vertex] != emittedCount)
+                {
+                    placedAtStep[vertex] = emittedCount;
+                    nextCache.push_back(vertex);
+                }
+            }
+
+            for (size_t i = 0; i < nextCache.size(); i++)
+            {
+                uint32_t vertex = nextCache[i];
+                cachePositions[vertex] = i < OPTIMIZER_VERTEX_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+                vertexScores[vertex] = vertexScore(cachePositions[vertex], liveTriangleCounts[vertex]);
+            }
+
+            bestScore = -1.0f;
+            for (uint32_t vertex : nextCache)
+            {
+                const uint32_t *first = adjacency.data() + adjacencyOffsets[vertex];
+                for (const uint32_t *triangle = first; triangle != first + liveTriangleCounts[vertex]; triangle++)
+                {
+                    float score = vertexScores[indices[*triangle * 3]] + vertexScores[indices[*triangle * 3 + 1]] + vertexScores[indices[*triangle * 3 + 2]];
+
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        bestTriangle = *triangle;
+                    }
+                }
+            }
+
+            if (nextCache.size() > OPTIMIZER_VERTEX_CACHE_SIZE)
+                nextCache.resize(OPTIMIZER_VERTEX_CACHE_SIZE);
+
+            std::swap(cache, nextCache);
+        }
+
+        return optimized;
+    }
+
+    // Reorders vertices by first use so fetches walk the vertex buffer linearly, unreferenced vertices are dropped
+    [[nodiscard]] static Mesh optimizeVertexFetch(const Mesh &mesh)
+    {
+        const std::vector<Vertex> &vertices = mesh.getVertices();
+
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+
+        std::vector<Vertex> orderedVertices;
+        orderedVertices.reserve(vertices.size());
+
+        std::vector<uint32_t> remappedIndices(mesh.getIndices());
+        for (uint32_t &index : remappedIndices)
+        {
+            if (remap[index] == UINT32_MAX)
+            {
+                remap[index] = static_cast<uint32_t>(orderedVertices.size());
+                orderedVertices.push_back(vertices[index]);
+            }
+
+            index = remap[index];
+        }
+
+        return Mesh(orderedVertices, remappedIndices, mesh.getMaterialIndex(), mesh.getTextureFilePath());
+    }
+
+    // Returns false when the mesh is too large or its texture coordinates too far from the origin to pack losslessly enough
+    [[nodiscard]] static bool packVertices(const std::vector<Vertex> &vertices, PackedMesh &packedMesh)
+    {
+        if (vertices.empty())
+            return false;
+
+        glm::vec3 boundsMin = vertices[0].pos;
+        glm::vec3 boundsMax = vertices[0].pos;
+        for (const Vertex &vertex : vertices)
+        {
+            if (std::abs(vertex.tex.x) > PACKED_VERTEX_MAX_TEXCOORD || std::abs(vertex.tex.y) > PACKED_VERTEX_MAX_TEXCOORD)
+                return false;
+
+            boundsMin = glm::min(boundsMin, vertex.pos);
+            boundsMax = glm::max(boundsMax, vertex.pos);
+        }
+
+        const glm::vec3 extent = boundsMax - boundsMin;
+        float scale = std::max(extent.x, std::max(extent.y, extent.z));
+        if (scale > PACKED_VERTEX_MAX_EXTENT)
+            return false;
+        if (scale <= 0.0f)
+            scale = 1.0f;
+
+        packedMesh.vertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            PackedVertex &packed = packedMesh.vertices[i];
+
+            const glm::vec3 unitPos = (vertex.pos - boundsMin) / scale;
+            packed.pos[0] = glm::packUnorm1x16(unitPos.x);
+            packed.pos[1] = glm::packUnorm1x16(unitPos.y);
+            packed.pos[2] = glm::packUnorm1x16(unitPos.z);
+            packed.pos[3] = 0;
+
+            glm::vec3 normal = vertex.norm / (std::abs(vertex.norm.x) + std::abs(vertex.norm.y) + std::abs(vertex.norm.z));
+            glm::vec2 octahedral(normal.x, normal.y);
+            if (normal.z < 0.0f)
+            {
+                octahedral.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+                octahedral.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+            }
+            packed.norm[0] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.x));
+            packed.norm[1] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.y));
+
+            packed.tex[0] = glm::packHalf1x16(vertex.tex.x);
+            packed.tex[1] = glm::packHalf1x16(vertex.tex.y);
+        }
+
+        packedMesh.dequantizeMat = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), glm::vec3(scale));
+
+        return true;
+    }
+
+    [[nodiscard]] static Mesh optimizeMesh(const Mesh &mesh)
+    {
+        Mesh welded = weldVertices(mesh);
+
+        Mesh cacheOptimized(welded.getVertices(), optimizeVertexCache(welded.getIndices(), welded.getVertices().size()), welded.getMaterialIndex(), welded.getTextureFilePath());
+
+        return optimizeVertexFetch(cacheOptimized);
+    }
+
+}
@@ -0,0 +1,103 @@
+// Copyright 2025 Emil Dimov
+// Licensed under the Apache License, Version 2.0
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace VE
+{
+
+    // Bounded lock-free multi-producer multi-consumer queue, capacity must be a power of two
+    template <typename T>
+    class MpmcQueue
+    {
+    public:
+        explicit MpmcQueue(size_t capacity) : cells(std::make_unique<Cell[]>(capacity)), mask(capacity - 1)
+        {
+            for (size_t i = 0; i < capacity; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(const MpmcQueue &) = delete;
+        MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+        [[nodiscard]] bool tryPush(T &&value)
+        {
+            size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+            while (true)
+            {
+                Cell &cell = cells[position & mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+                if (difference == 0)
+                {
+                    if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = std::move(value);
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        [[nodiscard]] bool tryPop(T &value)
+        {
+            size_t position = dequeuePosition.load(std::memory_order_relaxed);
+
+            while (true)
+            {
+                Cell &cell = cells[position & mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+                if (difference == 0)
+                {
+                    if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        value = std::move(cell.value);
+                        cell.sequence.store(position + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = dequeuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        const size_t mask;
+
+        // Producers and consumers spin on different cache lines
+        alignas(64) std::atomic<size_t> enqueuePosition = 0;
+        alignas(64) std::atomic<size_t> dequeuePosition = 0;
+    };
+
+}
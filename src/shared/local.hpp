@@ -3,4 +3,5 @@
 
 #pragma once
 
-#define DEVELOPER_MODE false
\ No newline at end of file
+#define DEVELOPER_MODE false
+#define COOKED_ASSETS_ONLY false